@@ -0,0 +1,110 @@
+#!/usr/bin/env bash
+# Copyright © 2024 Steven Marion <steven@dragons.fish>
+#
+# This file is part of arrgen.
+#
+# arrgen is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# arrgen is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+
+# generates arrays from random inputs of a range of sizes in each of arrgen's output styles, and compiles them with
+# each compiler found, printing a table of how long arrgen and the compiler took and the most memory the compiler used.
+# run with make compile_bench, from the top of the tree. these can be set in the environment:
+#   SIZES      input sizes in bytes. default 65536 1048576 8388608
+#   COMPILERS  C compilers to try, each with the C++ compiler of the same family. default whichever of gcc and clang exist
+#   CFLAGS     flags for every compile. default -O2
+#   STYLES     which of the styles below to run. default all of them
+set -eu
+
+arrgen=${ARRGEN:-./arrgen}
+measure=${MEASURE:-./bench/measure}
+# everything is run from the directory it's working in
+[[ $arrgen == /* ]] || arrgen="$PWD/$arrgen"
+[[ $measure == /* ]] || measure="$PWD/$measure"
+sizes=${SIZES:-65536 1048576 8388608}
+cflags=${CFLAGS:--O2}
+if [[ -z ${COMPILERS:-} ]]; then
+	COMPILERS=
+	for compiler in gcc clang; do
+		if command -v $compiler >/dev/null; then
+			COMPILERS="$COMPILERS $compiler"
+		fi
+	done
+fi
+# name, then the settings for it. c files are compiled as C, cpp_constexpr and module as C++
+all_styles=(
+	"base10"          "%base=10"
+	"base16"          "%base=16"
+	"base8"           "%base=8"
+	"base16_aligned"  "%base=16\n%aligned=yes"
+	"base10_line16"   "%base=10\n%line_length=16"
+	"base16_line16"   "%base=16\n%line_length=16"
+	"split_64k"       "%base=16\n%split_size=65536"
+	"shards_4"        "%base=16\n%shards=4"
+	"external_data"   "%external_data=gen_arrays.pack"
+	"cpp_constexpr"   "%base=16\n%cpp_constexpr=yes"
+	"module"          "%base=16\n%module_name=bench_assets"
+)
+styles=${STYLES:-}
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+printf '%-10s %-8s %-16s %8s %12s %10s %12s\n' size compiler style gen_s output_bytes compile_s max_rss_kib
+for size in $sizes; do
+	# 8 files of a size each, so the shards have something to balance
+	for i in 0 1 2 3 4 5 6 7; do
+		head -c $((size/8)) /dev/urandom >"$dir/input_$i.bin"
+	done
+	for compiler in $COMPILERS; do
+		case $compiler in
+			*gcc*) cxx=${compiler/gcc/g++} ;;
+			*clang*) cxx=${compiler/clang/clang++} ;;
+			*) cxx=c++ ;;
+		esac
+		for ((i=0; i<${#all_styles[@]}; i+=2)); do
+			style=${all_styles[i]}
+			if [[ -n $styles && " $styles " != *" $style "* ]]; then
+				continue
+			fi
+			work="$dir/$style"
+			rm -rf "$work"
+			mkdir "$work"
+			printf '%b\n' "${all_styles[i+1]}" >"$work/settings.arrgen"
+			printf '@../input_%s.bin\n' 0 1 2 3 4 5 6 7 >>"$work/settings.arrgen"
+			gen=($(cd "$work" && "$measure" "$arrgen" -f settings.arrgen))
+			output_bytes=$(cat "$work"/*.c "$work"/*.h "$work"/*.cppm 2>/dev/null | wc -c)
+			# one compiler run per file, like a build would do, one after another so the memory is the biggest of them
+			case $style in
+				cpp_constexpr)
+					printf '#include "gen_arrays.h"\n' >"$work/use.cpp"
+					command="$cxx -std=c++17 $cflags -c use.cpp"
+					;;
+				module)
+					if [[ $cxx == *g++* ]]; then
+						command="$cxx -std=c++20 -fmodules-ts $cflags -x c++ -c bench_assets.cppm"
+					else
+						command="$cxx -std=c++20 $cflags --precompile -x c++-module bench_assets.cppm -o bench_assets.pcm && $cxx -std=c++20 $cflags -c bench_assets.pcm"
+					fi
+					;;
+				*)
+					command="for file in *.c; do $compiler $cflags -c \"\$file\" || exit 1; done"
+					;;
+			esac
+			if compile=($(cd "$work" && "$measure" sh -c "$command" 2>/dev/null)); then
+				printf '%-10s %-8s %-16s %8s %12s %10s %12s\n' $size $compiler $style ${gen[0]} $output_bytes ${compile[0]} ${compile[1]}
+			else
+				printf '%-10s %-8s %-16s %8s %12s %10s %12s\n' $size $compiler $style ${gen[0]} $output_bytes failed -
+			fi
+		done
+	done
+done
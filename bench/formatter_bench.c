@@ -0,0 +1,261 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// times writeArrayContents on made-up inputs with every base, aligned and line_length setting, reading them the way
+// handlefile.c does for memory-mapped inputs and for streamed ones. run with make bench
+// the optional arguments are the biggest input size to try (default 1MiB, which keeps it under a minute, up to 256MiB)
+// and where to put the input file.
+// prints CSV, one line per run, so results from different builds can be compared. ARRGEN_NUM_REPEATS and
+// ARRGEN_BUFFER_SIZE can be changed with CFLAGS like any other build, eg make bench CFLAGS=-DARRGEN_NUM_REPEATS=16
+
+#include "../src/arrgen.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#   include <linux/perf_event.h>
+#   include <sys/ioctl.h>
+#   include <sys/syscall.h>
+#endif
+#include "../src/errors.h"
+#include "../src/timing.h"
+#include "../src/writearray.h"
+
+#define NUM_REPEATS 3U
+#define DEFAULT_MAX_SIZE (1024U*1024U)
+#define STRINGIFY(x) STRINGIFY_(x)
+#define STRINGIFY_(x) #x
+
+typedef enum {
+    CORPUS_ZERO,
+    CORPUS_RANDOM,
+    CORPUS_TEXT,
+    CORPUS_MIXED, // runs of the other three, of random lengths
+    NUM_CORPORA,
+} Corpus;
+
+static const char* const corpus_names_[NUM_CORPORA] = {"zero", "random", "text", "mixed"};
+
+static void fillCorpus(uint8_t* buf, size_t length, Corpus corpus)
+    ATTR_ACCESS(write_only, 1, 2)
+    ATTR_NONNULL;
+
+static void writeCorpusFile(const char* path, const uint8_t* buf, size_t length)
+    ATTR_ACCESS(read_only, 2, 3)
+    ATTR_NONNULL;
+
+static void formatMapped(FILE* out, const char* path, size_t line_limit)
+    ATTR_NONNULL;
+
+static void formatStreamed(FILE* out, const char* path, size_t line_limit)
+    ATTR_NONNULL;
+
+static uint64_t nextRandom(uint64_t* state)
+    ATTR_NONNULL;
+
+static int openCycleCounter(void);
+
+static uint64_t readCycleCounter(int fd);
+
+int main(int argc, char** argv) {
+    const size_t max_size = (argc>1 ? (size_t)strtoull(argv[1], NULL, 0) : DEFAULT_MAX_SIZE);
+    const char *path = (argc>2 ? argv[2] : "formatter_bench.bin");
+    static const size_t sizes[] = {64U*1024U, 1024U*1024U, 16U*1024U*1024U, 256U*1024U*1024U};
+    static const uint8_t bases[] = {8U, 10U, 16U};
+    static const size_t line_limits[] = {0U, 16U};
+    // the formatted text isn't what's being measured, only making it
+    FILE *out = fopen("/dev/null", "wb");
+    if (out==NULL)
+        myFatalErrno("/dev/null");
+    static char out_buf[1U<<20];
+    setvbuf(out, out_buf, _IOFBF, sizeof(out_buf));
+    const int cycle_counter = openCycleCounter();
+    printf("# buffer_size=%u num_repeats=%s cycles=%s\n",
+        (unsigned)ARRGEN_BUFFER_SIZE,
+#ifdef ARRGEN_NUM_REPEATS
+        STRINGIFY(ARRGEN_NUM_REPEATS),
+#else
+        "default",
+#endif
+        (cycle_counter>=0 ? "perf_event" : "unavailable"));
+    printf("corpus,size,base,aligned,line_length,path,mb_per_s,cycles_per_byte\n");
+    for (size_t size_index=0U; size_index<sizeof(sizes)/sizeof(sizes[0]) && sizes[size_index]<=max_size; size_index++) {
+        const size_t size = sizes[size_index];
+        uint8_t *buf = malloc(size);
+        if (buf==NULL)
+            myFatalErrno("failed to allocate %zu bytes", size);
+        for (Corpus corpus=0; corpus<NUM_CORPORA; corpus++) {
+            fillCorpus(buf, size, corpus);
+            writeCorpusFile(path, buf, size);
+            for (size_t base_index=0U; base_index<sizeof(bases); base_index++)
+            for (unsigned aligned=0U; aligned<2U; aligned++)
+            for (size_t line_index=0U; line_index<sizeof(line_limits)/sizeof(line_limits[0]); line_index++)
+            for (unsigned streamed=0U; streamed<2U; streamed++) {
+                initializeLookup(bases[base_index], aligned);
+                double best_seconds = -1.0;
+                uint64_t best_cycles = 0U;
+                for (unsigned repeat=0U; repeat<NUM_REPEATS; repeat++) {
+                    const uint64_t start_cycles = readCycleCounter(cycle_counter);
+                    const double start = monotonicSeconds();
+                    if (streamed)
+                        formatStreamed(out, path, line_limits[line_index]);
+                    else
+                        formatMapped(out, path, line_limits[line_index]);
+                    fflush(out);
+                    const double elapsed = monotonicSeconds()-start;
+                    const uint64_t cycles = readCycleCounter(cycle_counter)-start_cycles;
+                    if (best_seconds<0.0 || elapsed<best_seconds)
+                        best_seconds = elapsed;
+                    if (repeat==0U || cycles<best_cycles)
+                        best_cycles = cycles;
+                }
+                printf("%s,%zu,%u,%u,%zu,%s,%.1f,",
+                    corpus_names_[corpus],
+                    size,
+                    (unsigned)bases[base_index],
+                    aligned,
+                    line_limits[line_index],
+                    (streamed ? "stream" : "mmap"),
+                    (double)size/best_seconds/1e6);
+                if (cycle_counter>=0)
+                    printf("%.3f", (double)best_cycles/(double)size);
+                printf("\n");
+                fflush(stdout);
+            }
+        }
+        free(buf);
+    }
+    remove(path);
+    fclose(out);
+    return EXIT_SUCCESS;
+}
+
+static void fillCorpus(uint8_t* buf, size_t length, Corpus corpus) {
+    static const char text[] =
+        "#version 450\n"
+        "layout(location = 0) in vec2 uv;\n"
+        "layout(location = 0) out vec4 color;\n"
+        "uniform sampler2D tex; // the quick brown fox jumps over the lazy dog\n"
+        "void main() {\n"
+        "    color = texture(tex, uv) * vec4(1.0, 0.5, 0.25, 1.0);\n"
+        "}\n";
+    // the same every run, so results are comparable
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    size_t i = 0U;
+    while (i<length) {
+        Corpus run_corpus = corpus;
+        size_t run_length = length-i;
+        if (corpus==CORPUS_MIXED) {
+            run_corpus = (Corpus)(nextRandom(&state)%CORPUS_MIXED);
+            run_length = 1U+(size_t)(nextRandom(&state)%4096U);
+            if (run_length>length-i)
+                run_length = length-i;
+        }
+        for (size_t j=0U; j<run_length; j++, i++) {
+            switch (run_corpus) {
+            case CORPUS_ZERO:
+                buf[i] = 0U;
+                break;
+            case CORPUS_RANDOM:
+                buf[i] = (uint8_t)nextRandom(&state);
+                break;
+            default:
+                buf[i] = (uint8_t)text[i%(sizeof(text)-1U)];
+            }
+        }
+    }
+}
+
+static void writeCorpusFile(const char* path, const uint8_t* buf, size_t length) {
+    FILE *file = fopen(path, "wb");
+    if (file==NULL)
+        myFatalErrno("%s", path);
+    if (fwrite(buf, 1, length, file)!=length || fclose(file)!=0)
+        myFatalErrno("%s: write", path);
+}
+
+// what writeFileContents does for regular files
+static void formatMapped(FILE* out, const char* path, size_t line_limit) {
+    int fd = open(path, O_RDONLY);
+    struct stat stats;
+    if (fd<0 || fstat(fd, &stats)!=0)
+        myFatalErrno("%s", path);
+    const size_t length = (size_t)stats.st_size;
+    const uint8_t *mem = (const uint8_t*)mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (mem==MAP_FAILED)
+        myFatalErrno("%s: mmap", path);
+    close(fd);
+    madvise((void*)mem, length, MADV_SEQUENTIAL);
+    ssize_t cur_line_pos = -1;
+    writeArrayContents(out, mem, length, &cur_line_pos, line_limit);
+    munmap((void*)mem, length);
+}
+
+// what writeArrayStreamed does for pipes and the like
+static void formatStreamed(FILE* out, const char* path, size_t line_limit) {
+    static uint8_t buf[ARRGEN_BUFFER_SIZE];
+    FILE *in = fopen(path, "rb");
+    if (in==NULL)
+        myFatalErrno("%s", path);
+    ssize_t cur_line_pos = -1;
+    size_t num_read;
+    do {
+        num_read = fread(buf, 1, ARRGEN_BUFFER_SIZE, in);
+        writeArrayContents(out, buf, num_read, &cur_line_pos, line_limit);
+    } while (num_read==ARRGEN_BUFFER_SIZE);
+    fclose(in);
+}
+
+// xorshift64*
+static uint64_t nextRandom(uint64_t* state) {
+    *state ^= *state>>12;
+    *state ^= *state<<25;
+    *state ^= *state>>27;
+    return *state*0x2545F4914F6CDD1DULL;
+}
+
+// user-space cycles of this thread, which is usually allowed even with perf_event_paranoid at 2. -1 if it isn't
+static int openCycleCounter(void) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd>=0)
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+static uint64_t readCycleCounter(int fd) {
+    uint64_t count = 0U;
+    if (fd>=0 && read(fd, &count, sizeof(count))!=(ssize_t)sizeof(count))
+        count = 0U;
+    return count;
+}
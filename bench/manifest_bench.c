@@ -0,0 +1,75 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// times reading settings files with more and more inputs, to check that it stays linear. run with make bench
+
+#include "../src/arrgen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/errors.h"
+#include "../src/parameters.h"
+#include "../src/timing.h"
+
+#define NUM_REPEATS 5U
+
+static void writeManifest(const char* path, size_t num_inputs)
+    ATTR_NONNULL;
+
+int main(int argc, char** argv) {
+    const char *path = (argc>1 ? argv[1] : "manifest_bench.arrgen");
+    static const size_t sizes[] = {1000U, 10000U, 100000U};
+    printf("%10s %12s %14s\n", "inputs", "best ms", "ns per input");
+    for (size_t i=0U; i<sizeof(sizes)/sizeof(sizes[0]); i++) {
+        writeManifest(path, sizes[i]);
+        double best = -1.0;
+        for (unsigned repeat=0U; repeat<NUM_REPEATS; repeat++) {
+            double start = monotonicSeconds();
+            initializeParams();
+            params_->params_file = path;
+            parseParamsFile(path);
+            finishParams();
+            double elapsed = monotonicSeconds()-start;
+            freeParams(params_, &defaults_);
+            if (best<0.0 || elapsed<best)
+                best = elapsed;
+        }
+        printf("%10zu %12.2f %14.1f\n", sizes[i], best*1e3, best*1e9/(double)sizes[i]);
+    }
+    remove(path);
+    return EXIT_SUCCESS;
+}
+
+// a bit of everything that allocates: headers, prefix maps, attributes added to the defaults and to each input, and given names
+static void writeManifest(const char* path, size_t num_inputs) {
+    FILE *out = fopen(path, "w");
+    if (out==NULL)
+        myFatalErrno("%s", path);
+    fprintf(out, "%%c_path=bench_out.c\n%%path_prefix_map=/build=.\n");
+    for (unsigned i=0U; i<50U; i++)
+        fprintf(out, "%%extra_header=include/header_%u.h\n%%extra_system_header=system_%u.h\n", i, i);
+    fprintf(out, "%%attributes=__attribute__((aligned(16)))\n%%attributes=__attribute__((used))\n");
+    for (size_t i=0U; i<num_inputs; i++) {
+        fprintf(out, "@assets/directory_%zu/input_file_%zu.bin\n", i/100U, i);
+        if (i%4U==0U)
+            fprintf(out, "%%attributes=__attribute__((section(\".assets\")))\n%%base=16\n");
+        if (i%10U==0U)
+            fprintf(out, "%%array_name=NAMED_%zu\n", i);
+    }
+    if (fclose(out)!=0)
+        myFatalErrno("%s", path);
+}
@@ -0,0 +1,61 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// runs a command and prints how long it took in seconds and the most memory it or anything it ran used in KiB, for
+// compile_bench.sh, since GNU time isn't everywhere. exits with the command's exit status
+
+#include "../src/arrgen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../src/errors.h"
+#include "../src/timing.h"
+
+int main(int argc, char** argv) {
+    if (argc<2) {
+        fprintf(stderr, "usage: %s COMMAND [ARGUMENTS...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const double start = monotonicSeconds();
+    const pid_t pid = fork();
+    if (pid<0)
+        myFatalErrno("fork");
+    if (pid==0) {
+        execvp(argv[1], &argv[1]);
+        myFatalErrno("%s", argv[1]);
+    }
+    int status;
+    struct rusage usage;
+    // with wait4, the child's usage includes the children it waited for, so a shell running several compilers counts the biggest
+    if (wait4(pid, &status, 0, &usage)<0)
+        myFatalErrno("wait4");
+    const double elapsed = monotonicSeconds()-start;
+#ifdef __APPLE__
+    const long max_rss = usage.ru_maxrss/1024; // bytes there, KiB everywhere else
+#else
+    const long max_rss = usage.ru_maxrss;
+#endif
+    printf("%.3f %ld\n", elapsed, max_rss);
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+    return EXIT_FAILURE;
+}
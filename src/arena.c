@@ -0,0 +1,129 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arrgen.h"
+#include "arena.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "errors.h"
+
+#ifndef ARRGEN_ARENA_BLOCK_SIZE
+#   define ARRGEN_ARENA_BLOCK_SIZE 65536U
+#endif
+
+struct ArenaBlock {
+    ArenaBlock *previous;
+    char data[];
+};
+
+static char* allocateInArena(Arena* arena, size_t size, size_t alignment)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL;
+
+static void addArenaBlock(Arena* arena, size_t min_size)
+    ATTR_NONNULL;
+
+void* arenaAlloc(Arena* arena, size_t size) {
+    return allocateInArena(arena, size, _Alignof(max_align_t));
+}
+
+char* arenaDuplicateString(Arena* arena, const char* str) {
+    return arenaDuplicateStringLen(arena, str, strlen(str));
+}
+
+char* arenaDuplicateStringLen(Arena* arena, const char* str, size_t length) {
+    char *ret = allocateInArena(arena, length+1U, 1U);
+    memcpy(ret, str, length);
+    ret[length] = '\0';
+    return ret;
+}
+
+char* arenaSprintfAppend(Arena* arena, char* base, const char* format, ...) {
+    va_list args, args_copy;
+    va_start(args, format);
+    va_copy(args_copy, args);
+    int len_to_append = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (UNLIKELY(len_to_append<0))
+        myFatalErrno("vsnprintf: %s", format);
+    char *ret;
+    size_t previous_len;
+    if (base!=NULL && base==arena->last) {
+        // it ends right where the next allocation would start, so the length is already known
+        previous_len = (size_t)(arena->next-base) - 1U;
+        if ((size_t)(arena->end-arena->next) >= (size_t)len_to_append) {
+            ret = base;
+            arena->next += len_to_append;
+        } else {
+            // twice the room it needs, so the next appends fit too
+            addArenaBlock(arena, (previous_len+(size_t)len_to_append+1U)*2U);
+            ret = allocateInArena(arena, previous_len+(size_t)len_to_append+1U, 1U);
+            memcpy(ret, base, previous_len);
+        }
+    } else {
+        previous_len = (base==NULL ? 0U : strlen(base));
+        ret = allocateInArena(arena, previous_len+(size_t)len_to_append+1U, 1U);
+        if (base!=NULL)
+            memcpy(ret, base, previous_len);
+    }
+    vsnprintf(&ret[previous_len], (size_t)len_to_append+1U, format, args_copy);
+    va_end(args_copy);
+    arena->last = ret;
+    return ret;
+}
+
+void freeArena(Arena* arena) {
+    ArenaBlock *block = arena->blocks;
+    while (block!=NULL) {
+        ArenaBlock *previous = block->previous;
+        free(block);
+        block = previous;
+    }
+    *arena = (Arena) {
+        .blocks = NULL,
+    };
+}
+
+static char* allocateInArena(Arena* arena, size_t size, size_t alignment) {
+    char *ret = arena->next;
+    size_t padding = (ret==NULL ? 0U : (alignment-(uintptr_t)ret%alignment)%alignment);
+    if (UNLIKELY(arena->next==NULL || (size_t)(arena->end-arena->next) < padding+size)) {
+        addArenaBlock(arena, size+alignment);
+        ret = arena->next;
+        padding = (alignment-(uintptr_t)ret%alignment)%alignment;
+    }
+    ret += padding;
+    arena->next = ret+size;
+    arena->last = ret;
+    return ret;
+}
+
+// whatever is left of the current block is wasted
+static void addArenaBlock(Arena* arena, size_t min_size) {
+    size_t size = (min_size>ARRGEN_ARENA_BLOCK_SIZE ? min_size : ARRGEN_ARENA_BLOCK_SIZE);
+    ArenaBlock *block = malloc(sizeof(ArenaBlock)+size);
+    if (UNLIKELY(block==NULL))
+        myFatalErrno("failed to allocate %zu bytes", sizeof(ArenaBlock)+size);
+    DLOG("new block of %zu bytes", size);
+    block->previous = arena->blocks;
+    arena->blocks = block;
+    arena->next = block->data;
+    arena->end = &block->data[size];
+}
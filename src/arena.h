@@ -0,0 +1,78 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARENA_H_INCLUDED
+#define ARENA_H_INCLUDED
+#include "arrgen.h"
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct ArenaBlock ArenaBlock;
+
+// memory for lots of small things that are all freed at once, like everything read from one settings file.
+// an arena with everything set to NULL is empty and ready to use
+typedef struct {
+    ArenaBlock *blocks; // the newest one first
+    char *next; // where the next allocation goes in the newest block
+    char *end;
+    char *last; // the most recent allocation, which arenaSprintfAppend can grow in place
+} Arena;
+
+/**
+ * @brief allocates memory aligned for any type, which stays valid until freeArena. failure is fatal
+*/
+ATTR_NODISCARD
+void* arenaAlloc(Arena* arena, size_t size)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL;
+
+ATTR_NODISCARD
+char* arenaDuplicateString(Arena* arena, const char* str)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL;
+
+ATTR_NODISCARD
+char* arenaDuplicateStringLen(Arena* arena, const char* str ATTR_NONSTRING, size_t length)
+    ATTR_ACCESS(read_only, 2, 3)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL;
+
+/**
+ * @brief like sprintfAppend, but in the arena. if base was the last thing allocated in the arena, it's grown in place, so appending
+ * to the same string over and over stays linear. otherwise base is copied, and left as it was
+ * @param base NULL, or a string allocated in this arena
+*/
+ATTR_NODISCARD
+char* arenaSprintfAppend(Arena* arena, char* base, const char* format, ...)
+    ATTR_FORMAT(printf, 3, 4)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL_N(1)
+    ATTR_NONNULL_N(3);
+
+/**
+ * @brief frees everything allocated in the arena, and leaves it empty and ready to use again
+*/
+void freeArena(Arena* arena)
+    ATTR_NONNULL;
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // ARENA_H_INCLUDED
@@ -22,28 +22,49 @@
 #include <stdbool.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <limits.h>
 #include "errors.h"
 #include "handlefile.h"
+#include "outputfile.h"
 #include "writearray.h"
 #include "c_string_stuff.h"
 #include "parameters.h"
+#include "jobserver.h"
+#include "workers.h"
+#include "watch.h"
+#include "stats.h"
+#include "trace.h"
 #include "version_message.h"
 
 #define VERSION "0.6.0.next"
 
-#define DEFAULT_C_PATH "gen_arrays.c"
-#define DEFAULT_H_NAME "gen_arrays.h"
-
 static const char HELPTEXT[] =
     "arrgen version " VERSION ". Copyright 2024 Steven Marion\n"
     "Generates C arrays representing the contents of files, to embed files directly in compiled programs\n"
     "Usage:\n"
     "arrgen [OPTIONS]... FILE1 FILE2      Create a gen_arrays.c file with default parameters\n"
     "arrgen [OPTIONS]... -f FILE          Create a .c file with parameters and inputs loaded from FILE\n"
+    "arrgen [OPTIONS]... -f FILE1 -f FILE2...  Handle several parameter files in one process, in parallel. OPTIONS apply\n"
+    "                                     to all of them, and each one can override them\n"
     "Options:\n"
     "    --help          Display this help text\n"
     "    --version       Display version info\n"
+    "    --check         Do not write anything, exit with failure if any generated file is missing or out of date\n"
+    "    --watch         Keep running after generating, and generate again whenever the settings file or an input\n"
+    "                    changes, only reformatting the inputs that changed. Only on Linux\n"
+    "    --stats[=json]  When done, report what each input was (sizes, how it was read, how it was formatted), the time\n"
+    "                    spent parsing, reading, formatting and writing, how often repeated bytes were printed with a\n"
+    "                    single lookup, and the process's peak memory, page faults and system calls. As a table by default\n"
+    "    --stats_file=FILE  Write the stats to FILE instead of stderr. Implies --stats\n"
+    "    --trace=FILE    Write a timeline of parsing each settings file and opening, mapping, formatting and writing each\n"
+    "                    input and output, per thread, to FILE in the Chrome trace event format (for Perfetto or\n"
+    "                    chrome://tracing)\n"
+    "    --manifest_list=FILE  Handle every parameter file listed in FILE, one per line relative to FILE, as if each\n"
+    "                    was given with -f. Lines starting with # are skipped\n"
     "    --              End flag arguments, all following treated as input files\n"
+    "-j N                Handle up to N parameter files at once. Default is the number of processors. When run by a\n"
+    "                    GNU make with a jobserver (make -j), each one past the first also needs a free job slot from make,\n"
+    "                    and the default is as many as make allows\n"
     "-h                  Create header file (default)\n"
     "-H                  Do not create header file\n"
     "-a                  Vertically align the columns in generated arrays\n"
@@ -58,8 +79,64 @@ static const char HELPTEXT[] =
     "-8                  Octal (shortcut for --base=8)\n"
     "    --attributes=   In generated header, add attributes (eg __attribute__ ((whatever))) before declarations. Default off. can be used for eg memory alignment\n"
     "    --line_length=  Max num input bytes to print per line. Default 0 (no limit)\n"
+    "    --split_size=   Split inputs bigger than this many bytes into chunk arrays, each in its own .c file next to the main one,\n"
+    "                    accessed through a generated NAME_CHUNKS table. Default 0 (never split)\n"
+    "    --checksum=     Put checksums of each input in the header next to its length, as NAME_CRC32C and/or NAME_XXH64.\n"
+    "                    crc32c, xxh64, crc32c,xxh64 or none. They're computed while the input is being formatted,\n"
+    "                    so it's still only read once. Default none\n"
+    "    --transform=    Change the input before embedding it, as it's read. eol makes CRLF and CR line endings LF, text does\n"
+    "                    that and takes whitespace off the ends of lines (eg for HTML and CSS), json takes out whitespace and\n"
+    "                    // or /* */ comments outside strings, and clike (for GLSL and C) takes out comments and squashes\n"
+    "                    whitespace, keeping line breaks. The length and checksums are of the result. Default none\n"
+    "    --section=      Put the arrays in this section (with GCC-style attributes). Arrays in the same section in the same\n"
+    "                    .c file are kept or dropped by the linker together. Default none\n"
+    "    --alignment=    Align the arrays' addresses to this many bytes, a power of 2, page (4096) or hugepage (2MiB).\n"
+    "                    Default 0 (up to the compiler)\n"
+    "    --pad_to=       Pad each array with zeros to a multiple of this many bytes, so it can be read in whole vectors.\n"
+    "                    Its declared size is then NAME_PADDED_LENGTH, and the length is still the input's. Default 0 (none)\n"
+    "    --gc_sections=  Put each array without a section in a section of its own, so the linker's --gc-sections can drop\n"
+    "                    the ones that aren't used, even without -fdata-sections. ELF only. Default no\n"
     "    --c_path=       Put the generated .c file at this location. Default " DEFAULT_C_PATH "\n"
+    "                    - writes it to stdout instead, eg to pipe it into cc -x c -, with the header (if any)\n"
+    "                    written relative to the current directory\n"
     "    --h_name=       Put the generated (or referenced) header file at this location relative to the .c file. Default " DEFAULT_H_NAME "\n"
+    "    --shards=       Spread the arrays over this many .c files (named like gen_arrays.0.c) balanced by input size,\n"
+    "                    or per_input for one .c file per input (named like gen_arrays.ARRGEN_FOO_PNG.c), instead of\n"
+    "                    writing a single file at c_path. Default 1\n"
+    "    --output_list=  Write the paths of all generated files to this file, one per line, for the build system\n"
+    "    --depfile=      Write a makefile fragment to this file saying the generated files depend on the parameter file,\n"
+    "                    the inputs, and the extra headers (like gcc -MMD -MP)\n"
+    "    --cache_dir=    Keep the formatted text of each input in this directory, keyed by a hash of its contents and\n"
+    "                    the formatting settings, and reuse it instead of formatting unchanged inputs again.\n"
+    "                    Nothing is ever deleted from it\n"
+    "    --external_data=  Put the contents of the inputs in this pack file instead, for development builds that shouldn't\n"
+    "                    have to recompile anything when an input changes. The .c file becomes a loader that maps the pack\n"
+    "                    the first time an array is used, and the arrays and lengths in the header become macros calling it,\n"
+    "                    so the lengths aren't constant expressions. The pack is found at its absolute path at generation\n"
+    "                    time, or at $NAME_PATH, where NAME comes from the pack's file name. shards and split_size are ignored\n"
+    "    --cpp_constexpr=  Write a C++17 header with the arrays defined in it as inline constexpr unsigned char NAME[],\n"
+    "                    with constexpr NAME_LENGTH (and NAME_SPAN, a std::span, with C++20), so they can be used in constant\n"
+    "                    expressions. No .c file is written, and c_path only says where the header goes. Default no\n"
+    "    --module_name=  Write a C++20 module interface unit with this name instead of a header, exporting the same things\n"
+    "                    as cpp_constexpr (which it implies), so the arrays are only parsed once, when the module is built.\n"
+    "                    h_name defaults to NAME.cppm. With header_per_input, each input is a partition of the module\n"
+    "    --extern_length=  Declare the lengths in the generated header as extern const size_t, defined in the .c files,\n"
+    "                    so the header only changes when names do, not when an input's size does. Default no\n"
+    "    --header_per_input=  Write a separate header for each input (named like gen_arrays.ARRGEN_FOO_PNG.h), and make\n"
+    "                    the main header just include all of them. Default no\n"
+    "    --reproducible= Make the output depend only on the inputs and parameters, not on where they are: input paths\n"
+    "                    in comments go through path_prefix_map and absolute ones are cut down to their base names,\n"
+    "                    and include guards are made from the names declared instead of the header's path. Array\n"
+    "                    and length names still come from the paths as given. Default no\n"
+    "    --path_prefix_map=OLD=NEW  In reproducible mode, replace OLD at the start of input paths with NEW. Can be\n"
+    "                    given more than once, the last one that matches is used\n"
+    "In a parameter file, an @ line with *, ? or [ in it is a pattern, matched a path component at a time like a shell\n"
+    "glob, where ** matches any number of directories. One ending in / means every file under that directory. The files\n"
+    "found are added in sorted order, named after their paths like any other input, and the parameters after the\n"
+    "pattern apply to each of them. If a file with exactly that name exists (like icon[2x].png), it's used as is instead\n"
+    "An @ line ARCHIVE.tar:NAME adds the file NAME in a tar archive, read straight out of the archive without extracting\n"
+    "it, and ARCHIVE.tar:* adds every file in it, in archive order. They're named after ARCHIVE.tar:NAME, and compressed\n"
+    "archives aren't supported. An @ line that's just ARCHIVE.tar embeds the archive itself, like any other file\n"
     "TODO describe defaults and input file format\n"
     "TODO update this help text to match latest updates\n"
     ;
@@ -68,31 +145,46 @@ static const char HELPTEXT[] =
 static const char* VERSIONTEXT =
     "arrgen version " VERSION ". Copyright © 2024 Steven Marion\n"
     ARRGEN_MMAP_VERSION_MESSAGE
+    ARRGEN_THREADS_VERSION_MESSAGE
     ARRGEN_VERSION_MESSAGE
     ;
 
-static void parseParamsFile(const char* path)
+static void parseManifestList(const char* path)
+    ATTR_NONNULL;
+
+static void addParamsFile(char* path)
     ATTR_NONNULL;
 
-static void freeIfNonNull(const void *ptr);
+static bool handleParamsFile(size_t index, void* arg);
+
+static bool generateFromParams(void);
+
+static void cleanUpAfterFatal(void);
 
-const char* program_name_;
+#ifdef ARRGEN_WATCH_SUPPORTED
+ATTR_NORETURN
+static void watchAndRegenerate(void);
+#endif // ARRGEN_WATCH_SUPPORTED
+
+// every parameter file given with -f or listed in a manifest_list, handled one per task
+static char** params_files_ = NULL;
+static size_t num_params_files_ = 0U;
+// what was given on the command line, which every parameter file starts from
+static OutputFileParams* template_params_ = NULL;
+static InputFileParams template_defaults_;
 
 int main(int arg_num, const char** args) {
     DLOG("arrgen_pagesize_ = %u", arrgen_pagesize_);
     DLOG("current_params_size_ = %zu", current_params_size_);
     program_name_ = args[0];
+    setFatalCleanup(cleanUpAfterFatal);
 
-    params_ = malloc(current_params_size_);
-    if (UNLIKELY(params_==NULL))
-        myFatalErrno("failed to allocate %zu bytes", current_params_size_);
-    params_->c_path = NULL;
-    params_->h_name = NULL;
-    params_->header_top_text = NULL;
-    params_->params_file = NULL;
-    params_->create_header = true;
-    params_->constexpr_length = false;
-    params_->num_inputs = 0;
+    initializeParams();
+    unsigned num_threads = 0U; // 0 means one per processor
+    bool watch = false;
+    const char *stats_format = NULL;
+    const char *stats_file = NULL;
+    const char *trace_file = NULL;
 
     bool flags_end_found = false;
     bool skip_second_arg = false;
@@ -111,7 +203,21 @@ int main(int arg_num, const char** args) {
                 } else if (!strcmp(&args[i][2], "version")) {
                     fwrite(VERSIONTEXT, strlen(VERSIONTEXT), 1, stdout);
                     return 0;
-                } else
+                } else if (!strcmp(&args[i][2], "check"))
+                    params_->check_only = true;
+                else if (!strcmp(&args[i][2], "watch"))
+                    watch = true;
+                else if (!strcmp(&args[i][2], "stats"))
+                    stats_format = "text";
+                else if (!strncmp(&args[i][2], "stats=", strlen("stats=")))
+                    stats_format = &args[i][2+strlen("stats=")];
+                else if (!strncmp(&args[i][2], "stats_file=", strlen("stats_file=")))
+                    stats_file = &args[i][2+strlen("stats_file=")];
+                else if (!strncmp(&args[i][2], "trace=", strlen("trace=")))
+                    trace_file = &args[i][2+strlen("trace=")];
+                else if (!strncmp(&args[i][2], "manifest_list=", strlen("manifest_list=")))
+                    parseManifestList(&args[i][2+strlen("manifest_list=")]);
+                else
                     myFatal("unknown long flag %s", args[i]);
             } else
                 for (const char* c=&args[i][1]; *c!='\0'; c++)
@@ -128,11 +234,16 @@ int main(int arg_num, const char** args) {
                     case 'x': defaults_.base = 16U; continue;
                     case '8': defaults_.base = 8U; continue;
                     case 'f':
-                        if (params_->params_file != NULL)
-                            myFatal("you can only give one file if using -f");
-                        else if (i+1 == arg_num)
+                        if (i+1 == arg_num)
                             myFatal("you passed -f but did not give a file");
-                        params_->params_file = args[i+1];
+                        addParamsFile(duplicateString(args[i+1]));
+                        skip_second_arg = true;
+                        continue;
+                    case 'j':
+                        if (i+1 == arg_num)
+                            myFatal("you passed -j but did not give a number of threads");
+                        if (UNLIKELY((num_threads = parseUint32(args[i+1], strlen(args[i+1])))==0U))
+                            myFatal("-j must be at least 1");
                         skip_second_arg = true;
                         continue;
                     default:
@@ -142,64 +253,170 @@ int main(int arg_num, const char** args) {
             newInputFile(args[i], false);
     }
 
-    if (params_->params_file==NULL) {
+    if (stats_format!=NULL || stats_file!=NULL) {
+        if (UNLIKELY(stats_format!=NULL && strcmp(stats_format, "text") && strcmp(stats_format, "json")))
+            myFatal("--stats must be text or json, not %s", stats_format);
+        // watch mode never finishes, so there'd be nothing to report
+        if (UNLIKELY(watch))
+            myFatal("cannot use both --watch and --stats");
+        enableStats(stats_format!=NULL && !strcmp(stats_format, "json"), stats_file);
+    }
+    if (trace_file!=NULL) {
+        if (UNLIKELY(watch))
+            myFatal("cannot use both --watch and --trace");
+        if (UNLIKELY(!startTrace(trace_file)))
+            exit(EXIT_FAILURE);
+    }
+
+    if (watch) {
+#ifdef ARRGEN_WATCH_SUPPORTED
+        if (UNLIKELY(num_params_files_>1U))
+            myFatal("--watch only works with one settings file");
+        if (UNLIKELY(params_->check_only))
+            myFatal("cannot use both --watch and --check");
+        if (UNLIKELY(num_params_files_==0U && params_->num_inputs == 0))
+            myFatal("you forgot to give me any files");
+        if (UNLIKELY(num_params_files_>0U && params_->num_inputs > 0))
+            myFatal("%s: cannot give other files on command line if passing settings file %s", params_->inputs[0].path_original, params_files_[0]);
+        watchAndRegenerate();
+#else
+        myFatal("--watch is not supported on this system");
+#endif // ARRGEN_WATCH_SUPPORTED
+    }
+
+    bool status;
+    if (num_params_files_==0U) {
         if (UNLIKELY(params_->num_inputs == 0))
             myFatal("you forgot to give me any files");
+        status = generateFromParams();
     } else {
         if (UNLIKELY(params_->num_inputs > 0))
-            myFatal("%s: cannot give other files on command line if passing settings file %s", params_->inputs[0].path_original, params_->params_file);
-        parseParamsFile(params_->params_file);
+            myFatal("%s: cannot give other files on command line if passing settings file %s", params_->inputs[0].path_original, params_files_[0]);
+        // every parameter file would write to the same place
+        if (UNLIKELY(num_params_files_>1U && (params_->c_path!=NULL || params_->output_list!=NULL || params_->depfile!=NULL)))
+            myFatal("cannot give c_path, output_list or depfile on the command line with more than one settings file");
+        template_params_ = params_;
+        template_defaults_ = defaults_;
+        Jobserver *jobserver = (num_threads!=1U && num_params_files_>1U ? connectJobserver() : NULL);
+        // with a jobserver, make already decides how many things run at once
+        if (num_threads==0U)
+            num_threads = (jobserver!=NULL ? UINT_MAX : defaultNumThreads());
+        status = runParallel(num_params_files_, num_threads, jobserver, handleParamsFile, NULL);
+        if (jobserver!=NULL)
+            disconnectJobserver(jobserver);
+        DLOG("deallocating template");
+        freeParams(template_params_, &template_defaults_);
+        for (size_t i=0U; i<num_params_files_; i++)
+            free(params_files_[i]);
+        free(params_files_);
     }
+    writeStats();
+    finishTrace();
+    exit(status ? EXIT_SUCCESS : EXIT_FAILURE);
+}
 
-    // hmm. if I bother to free any of this memory, will need to probably duplicate this string instead of just assigning the pointer
-    // maybe I should move this default-setting to a dedicated function? hmm
-    if (params_->c_path == NULL)
-        params_->c_path = duplicateString(DEFAULT_C_PATH);
-    if (params_->h_name == NULL)
-        params_->h_name = duplicateString(DEFAULT_H_NAME);
-
-    for (size_t i=0; i<params_->num_inputs; i++) {
-        InputFileParams *input = &params_->inputs[i];
-        // TODO figure out how to track which ones are malloc'd? Or maybe I just don't bother to free them
-        if (input->array_name==NULL)
-            input->array_name = createCName(input->path_original, strlen(input->path_original), "");
-        if (input->length_name==NULL)
-            input->length_name = createCName(input->path_original, strlen(input->path_original), "_LENGTH");
-        // alignment null is fine
-    }
+// runs on one of the worker threads, where params_ and defaults_ start out as whatever that thread last used
+static bool handleParamsFile(size_t index, void* arg ATTR_UNUSED) {
+    DLOG("%zu: %s", index, params_files_[index]);
+    const double parse_start = statsNow();
+    const double trace_start = traceNow();
+    startParamsFrom(template_params_, &template_defaults_);
+    params_->params_file = params_files_[index];
+    parseParamsFile(params_->params_file);
+    // the settings files are handled at the same time, so their .c files would be mixed together
+    if (UNLIKELY(num_params_files_>1U && params_->c_path!=NULL && isStdoutPath(params_->c_path)))
+        myFatal("%s: cannot write the .c file to stdout with more than one settings file", params_->params_file);
+    statsAddTime(STATS_PARSE, parse_start);
+    traceSpan("parse", params_->params_file, trace_start);
+    return generateFromParams();
+}
 
+static bool generateFromParams(void) {
+    const double parse_start = statsNow();
+    const double trace_start = traceNow();
+    finishParams();
+    statsAddTime(STATS_PARSE, parse_start);
+    traceSpan("finish_params", params_->params_file, trace_start);
     bool status = handleFile(params_);
-
-#ifndef NDEBUG
+    // even in release builds, since with settings files this runs once for each of them
     DLOG("deallocating");
-    for (size_t i=0U; i<params_->num_inputs; i++) {
-        InputFileParams *cur = &params_->inputs[i];
-        DLOG("path_original %zu", i);
-        freeIfNonNull(cur->path_original);
-        DLOG("path_to_open %zu", i);
-        if (cur->path_to_open!=cur->path_original)
-            freeIfNonNull(cur->path_to_open);
-        DLOG("length_name %zu", i);
-        freeIfNonNull(cur->length_name);
-        DLOG("array_name %zu", i);
-        freeIfNonNull(cur->array_name);
-        DLOG("attributes %zu", i);
-        freeIfNonNull(cur->attributes);
+    freeParams(params_, &defaults_);
+    params_ = NULL;
+    return status;
+}
+
+// a fatal error quits from wherever it happened, which could be partway through writing outputs on any of the threads
+static void cleanUpAfterFatal(void) {
+    abandonHandleFile();
+    removeTempOutputFiles();
+}
+
+#ifdef ARRGEN_WATCH_SUPPORTED
+// keeps going until something fatal happens. a change to the settings file means reading it again and starting over,
+// a change to an input only means formatting that input again
+static void watchAndRegenerate(void) {
+    const char *params_file = (num_params_files_>0U ? params_files_[0] : NULL);
+    if (params_file!=NULL) {
+        template_params_ = params_;
+        template_defaults_ = defaults_;
+        params_ = NULL;
     }
-    DLOG("c_path");
-    free((void*)params_->c_path);
-    DLOG("h_name");
-    free((void*)params_->h_name);
-    DLOG("header_top_text");
-    freeIfNonNull(params_->header_top_text);
-    DLOG("params_");
-    free(params_);
-#endif // NDEBUG
-    // Do not deallocate params_file, it wasn't allocated
-    exit(status ? EXIT_SUCCESS : EXIT_FAILURE);
+    Watcher *watcher = NULL;
+    const char **paths = NULL;
+    bool *changed = NULL;
+    bool reload = true;
+    for (;;) {
+        if (reload) {
+            if (params_file!=NULL) {
+                if (params_!=NULL)
+                    freeParams(params_, &defaults_);
+                startParamsFrom(template_params_, &template_defaults_);
+                params_->params_file = params_file;
+                parseParamsFile(params_file);
+            }
+            finishParams();
+            rememberArrays(params_->num_inputs);
+            if (watcher!=NULL)
+                stopWatching(watcher);
+            // the settings file goes last, after the inputs, so the indices of the inputs line up with the ones in params_
+            const size_t num_paths = params_->num_inputs + (params_file!=NULL);
+            paths = realloc(paths, sizeof(char*)*num_paths);
+            changed = realloc(changed, sizeof(bool)*num_paths);
+            if (UNLIKELY(paths==NULL || changed==NULL))
+                myFatalErrno("failed to allocate memory to watch %zu files", num_paths);
+            for (size_t i=0U; i<params_->num_inputs; i++)
+                paths[i] = params_->inputs[i].path_to_open;
+            if (params_file!=NULL)
+                paths[params_->num_inputs] = params_file;
+            // started before generating, so anything that changes while generating gets noticed too
+            watcher = startWatching(paths, num_paths);
+            reload = false;
+        }
+        // errors have already been reported, and the next change might fix them
+        handleFile(params_);
+        if (UNLIKELY(!waitForChanges(watcher, changed)))
+            exit(EXIT_FAILURE);
+        reload = (params_file!=NULL && changed[params_->num_inputs]);
+        for (size_t i=0U; i<params_->num_inputs; i++) {
+            if (changed[i])
+                forgetArray(i);
+            // the members could have moved, or been added or removed, so the archive has to be indexed again
+            if (changed[i] && params_->inputs[i].from_archive)
+                reload = true;
+        }
+    }
+}
+#endif // ARRGEN_WATCH_SUPPORTED
+
+static void addParamsFile(char* path) {
+    params_files_ = realloc(params_files_, sizeof(char*)*(num_params_files_+1U));
+    if (UNLIKELY(params_files_==NULL))
+        myFatalErrno("failed to allocate %zu bytes", sizeof(char*)*(num_params_files_+1U));
+    params_files_[num_params_files_++] = path;
 }
 
-static void parseParamsFile(const char* path) {
+// one settings file per line, relative to the list file like input paths are relative to settings files
+static void parseManifestList(const char* path) {
     FILE* in = fopen(path, "rt");
     if (UNLIKELY(in==NULL))
         myFatalErrno("%s", path);
@@ -208,50 +425,14 @@ static void parseParamsFile(const char* path) {
     if (UNLIKELY(buf==NULL))
         myFatalErrno("failed to allocate %zu bytes", buf_size);
     ssize_t num_read;
-    unsigned cur_line = 0;
-#ifdef ARRGEN_GETLINE_SUPPORTED
-    // TODO find a cleaner way to write this ifdef
-    while (LIKELY((num_read = getline(&buf, &buf_size, in)) > 0)) {
-#else
-    while (LIKELY(fgets(buf, PATH_MAX, in)!=NULL)) {
-        num_read = strlen(buf);
-        if (UNLIKELY(num_read>=(PATH_MAX-1)))
-            myFatal("%s: lines too long (system does not have GNU getline)", path);
-#endif
-        cur_line++;
-        // remove the trailing newline if it's there
-        if (buf[num_read-1]=='\n') {
-            num_read--;
-            buf[num_read] = '\0';
-        }
-        // skip empty lines
-        if (UNLIKELY(num_read==0))
-            continue;
-        // parse the line
-        switch (buf[0]) {
-        case '#': // it's a comment line
-            break;
-        case '@': // it's an input file path
-            newInputFile(&buf[1], true);
-            break;
-        case '%': // it's a parameter
-            if (!parseParameterLine(&buf[1], true))
-                myFatal("%s: line %u: invalid parameter line %s", path, cur_line, buf);
-            break;
-        default: // it's invalid
-            myFatal("%s: %s: currently all non-empty lines must start with %% or #, try --help", path, buf);
-        }
-    }
+    while (LIKELY((num_read = readLine(&buf, &buf_size, in, path)) >= 0))
+        if (num_read>0 && buf[0]!='#')
+            addParamsFile(pathRelativeToFile(path, buf));
     int error = errno;
     if (!LIKELY(feof(in))) {
         errno = error;
         myFatalErrno("%s", path);
     }
-    // TODO: free stuff, but only if DEBUG is defined
+    fclose(in);
     free(buf);
 }
-
-static void freeIfNonNull(const void *ptr) {
-    if (ptr!=NULL)
-        free((void*)ptr);
-}
@@ -71,6 +71,52 @@
 #   endif
 #endif
 
+// thread-local storage, for the globals each manifest gets its own copy of in batch mode
+#ifndef ARRGEN_THREAD_LOCAL
+#   if defined(__cplusplus)
+#       define ARRGEN_THREAD_LOCAL thread_local
+#   elif __STDC_VERSION__ >= 202311L
+#       define ARRGEN_THREAD_LOCAL thread_local
+#   elif __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+#       define ARRGEN_THREAD_LOCAL _Thread_local
+#   elif defined(__GNUC__)
+#       define ARRGEN_THREAD_LOCAL __thread
+#   endif
+#endif
+
+// whether manifests can be handled in parallel. without this, batch mode handles them one at a time
+#if !defined(ARRGEN_THREADS_SUPPORTED) && !defined(ARRGEN_NO_THREADS) && defined(ARRGEN_THREAD_LOCAL)
+#   if defined(__linux__) || defined(__APPLE__) || defined(__CYGWIN__)
+#       define ARRGEN_THREADS_SUPPORTED
+#   elif defined(__has_include)
+#       if __has_include(<pthread.h>)
+#           define ARRGEN_THREADS_SUPPORTED
+#       endif
+#   endif
+#endif
+#ifndef ARRGEN_THREAD_LOCAL
+#   ifdef ARRGEN_THREADS_SUPPORTED
+#       error "ARRGEN_THREADS_SUPPORTED requires thread-local storage"
+#   endif
+#   define ARRGEN_THREAD_LOCAL
+#endif
+
+// --watch uses inotify
+#if !defined(ARRGEN_WATCH_SUPPORTED) && defined(__linux__)
+#   define ARRGEN_WATCH_SUPPORTED
+#endif
+
+// sharing job slots with GNU make needs its jobserver pipe or fifo, and threads to use the slots with
+#if !defined(ARRGEN_JOBSERVER_SUPPORTED) && defined(ARRGEN_THREADS_SUPPORTED) && (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+#   define ARRGEN_JOBSERVER_SUPPORTED
+#endif
+
+#ifdef ARRGEN_THREADS_SUPPORTED
+#   define ARRGEN_THREADS_VERSION_MESSAGE "Built with support for handling manifests in parallel\n"
+#else
+#   define ARRGEN_THREADS_VERSION_MESSAGE "Built without thread support\n"
+#endif
+
 #if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
 #   define ARRGEN_MMAP_VERSION_MESSAGE "Built with support for POSIX mmap\n"
 #elif (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_WINDOWS)
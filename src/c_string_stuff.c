@@ -41,25 +41,47 @@ static uint8_t parseBase(char c)
 
 #define NAME_PREFIX "ARRGEN_"
 
-// hmm. is there an alternative to malloc for this?
+static char* writeCName(char* out, const char* name ATTR_NONSTRING, size_t name_length, const char* suffix)
+    ATTR_ACCESS(write_only, 1)
+    ATTR_ACCESS(read_only, 2, 3)
+    ATTR_ACCESS(read_only, 4)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL;
+
+static size_t cNameSize(size_t name_length, const char* suffix)
+    ATTR_PURE
+    ATTR_NONNULL;
+
 char* createCName(const char* name ATTR_NONSTRING, size_t name_length, const char* suffix) {
-    const size_t prefix_length = strlen(NAME_PREFIX);
-    const size_t suffix_length = strlen(suffix);
-    const size_t out_length = prefix_length+name_length+suffix_length+1; // +1 for null terminator
-    char *ret = malloc(out_length);
+    const size_t out_size = cNameSize(name_length, suffix);
+    char *ret = malloc(out_size);
     if (UNLIKELY(ret==NULL))
         myFatalErrno("malloc");
-    memcpy(ret, NAME_PREFIX, prefix_length);
+    return writeCName(ret, name, name_length, suffix);
+}
+
+char* arenaCreateCName(Arena* arena, const char* name ATTR_NONSTRING, size_t name_length, const char* suffix) {
+    char *ret = arenaAlloc(arena, cNameSize(name_length, suffix));
+    return writeCName(ret, name, name_length, suffix);
+}
+
+static size_t cNameSize(size_t name_length, const char* suffix) {
+    return strlen(NAME_PREFIX)+name_length+strlen(suffix)+1; // +1 for null terminator
+}
+
+static char* writeCName(char* out, const char* name ATTR_NONSTRING, size_t name_length, const char* suffix) {
+    const size_t prefix_length = strlen(NAME_PREFIX);
+    memcpy(out, NAME_PREFIX, prefix_length);
     for (size_t i=0; i<name_length; i++) {
         if (name[i]>='a' && name[i]<='z')
-            ret[prefix_length+i] = name[i]+('A'-'a');
+            out[prefix_length+i] = name[i]+('A'-'a');
         else if ((name[i]>='A' && name[i]<='Z') || (name[i]>='0' && name[i]<='9'))
-            ret[prefix_length+i] = name[i];
+            out[prefix_length+i] = name[i];
         else
-            ret[prefix_length+i] = '_';
+            out[prefix_length+i] = '_';
     }
-    memcpy(&ret[prefix_length+name_length], suffix, suffix_length+1);
-    return ret;
+    memcpy(&out[prefix_length+name_length], suffix, strlen(suffix)+1);
+    return out;
 }
 
 char* pathRelativeToFile(const char* base_file_path, const char* relative_path) {
@@ -79,6 +101,16 @@ char* pathRelativeToFile(const char* base_file_path, const char* relative_path)
     return ret;
 }
 
+char* pathWithoutExtension(const char* path) {
+    const char* last_slash = strrchr(path, '/');
+    const char* name = (last_slash==NULL ? path : last_slash+1);
+    const char* extension = strrchr(name, '.');
+    // a leading dot is a hidden file, not an extension
+    if (extension==NULL || extension==name)
+        return duplicateString(path);
+    return duplicateStringLen(path, extension-path);
+}
+
 #if __STDC_VERSION__ < 202000L
 char* duplicateString(const char* str) {
     return duplicateStringLen(str, strlen(str));
@@ -189,6 +221,19 @@ bool parseBool(const char *potential_bool, const char *param_name) {
 }
 // TODO: does msvc have equivalents to the builtins?
 
+void writeJsonString(FILE* out, const char* str) {
+    putc('"', out);
+    for (const char* c=str; *c!='\0'; c++) {
+        if (*c=='"' || *c=='\\')
+            fprintf(out, "\\%c", *c);
+        else if ((unsigned char)*c<0x20U)
+            fprintf(out, "\\u%04x", (unsigned)*c);
+        else
+            putc(*c, out);
+    }
+    putc('"', out);
+}
+
 static uint8_t parseBase(char c) {
     switch (c) {
         case 'b': return 2u;
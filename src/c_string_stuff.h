@@ -19,6 +19,8 @@
 #ifndef C_STRING_STUFF_H_INCLUDED
 #define C_STRING_STUFF_H_INCLUDED
 #include "arrgen.h"
+#include "arena.h"
+#include <stdio.h>
 #include <stdlib.h>
 
 ATTR_NODISCARD
@@ -29,6 +31,16 @@ char* createCName(const char* name ATTR_NONSTRING, size_t name_length, const cha
     ATTR_RETURNS_NONNULL
     ATTR_NONNULL;
 
+/**
+ * @brief the same as createCName, but allocated in arena
+*/
+ATTR_NODISCARD
+char* arenaCreateCName(Arena* arena, const char* name ATTR_NONSTRING, size_t name_length, const char* suffix)
+    ATTR_ACCESS(read_only, 2, 3)
+    ATTR_ACCESS(read_only, 4)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL;
+
 ATTR_NODISCARD
 char* pathRelativeToFile(const char* base_file_path, const char* relative_path)
     ATTR_ACCESS(read_only, 1)
@@ -37,6 +49,17 @@ char* pathRelativeToFile(const char* base_file_path, const char* relative_path)
     ATTR_RETURNS_NONNULL
     ATTR_NONNULL;
 
+/**
+ * @brief copies path, without the extension of the last path component (if it has one)
+ * @return pointer to the newly allocated string
+*/
+ATTR_NODISCARD
+char* pathWithoutExtension(const char* path)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_MALLOC(free)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL;
+
 // TODO: figure out if there's a convenient way to not need this
 #if __STDC_VERSION__ >= 202000L
 #   define duplicateString(a) strdup(a)
@@ -83,6 +106,13 @@ bool parseBool(const char *potential_bool, const char *param_name)
     ATTR_PURE
     ATTR_NONNULL;
 
+/**
+ * @brief writes str as a JSON string, with the quotes
+*/
+void writeJsonString(FILE* out, const char* str)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_NONNULL;
+
 // hmm. clean this up to be more portable (why did I write it this way? glibc should be the special case not the assumed default)
 #if !defined(__GLIBC__) && !defined(__CYGWIN__)
 const char* customBasename(const char* path)
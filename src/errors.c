@@ -29,6 +29,68 @@
 #   include <winbase.h>
 #endif
 
+const char* program_name_ = "arrgen"; // replaced with argv[0] by main
+
+// set by captureErrors, for libarrgen
+static ARRGEN_THREAD_LOCAL jmp_buf *fatal_jump_ = NULL;
+static ARRGEN_THREAD_LOCAL char *captured_messages_ = NULL;
+// set by setFatalCleanup, for the command line program
+static void (*fatal_cleanup_)(void) = NULL;
+
+static void reportError(const char* message, const char* reason)
+    ATTR_COLD
+    ATTR_NONNULL_N(1);
+
+ATTR_NORETURN
+static void fatalExit(void)
+    ATTR_COLD;
+
+void captureErrors(jmp_buf* fatal_jump) {
+    fatal_jump_ = fatal_jump;
+    free(captured_messages_);
+    captured_messages_ = NULL;
+}
+
+char* stopCapturingErrors(void) {
+    char *ret = captured_messages_;
+    fatal_jump_ = NULL;
+    captured_messages_ = NULL;
+    return ret;
+}
+
+void setFatalCleanup(void (*cleanup)(void)) {
+    fatal_cleanup_ = cleanup;
+}
+
+static void reportError(const char* message, const char* reason) {
+    if (fatal_jump_==NULL) {
+        if (reason==NULL)
+            fprintf(stderr, "%s: %s\n", program_name_, message);
+        else
+            fprintf(stderr, "%s: %s: %s\n", program_name_, message, reason);
+        return;
+    }
+    // not using sprintfAppend, it calls myFatal if it runs out of memory. losing the message is better than recursing
+    size_t old_length = (captured_messages_==NULL ? 0U : strlen(captured_messages_));
+    size_t new_length = old_length + strlen(message) + (reason==NULL ? 0U : strlen(reason)+2U) + 1U;
+    char *messages = realloc(captured_messages_, new_length+1U);
+    if (LIKELY(messages!=NULL)) {
+        sprintf(&messages[old_length], "%s%s%s\n", message, (reason==NULL ? "" : ": "), (reason==NULL ? "" : reason));
+        captured_messages_ = messages;
+    }
+}
+
+static void fatalExit(void) {
+    if (fatal_jump_!=NULL)
+        longjmp(*fatal_jump_, 1);
+    // cleared first, in case the cleanup has a fatal error of its own
+    void (*cleanup)(void) = fatal_cleanup_;
+    fatal_cleanup_ = NULL;
+    if (cleanup!=NULL)
+        cleanup();
+    exit(EXIT_FAILURE);
+}
+
 // I don't care about optimizing these functions for speed, so repeated calls to vsnprintf are fine.
 // TODO can I consolidate these by having the fatal ones call the error ones?
 
@@ -42,7 +104,7 @@ void myError(const char* restrict message, ...) {
         char buf[len+1];
         vsnprintf(buf, (size_t)len+1, message, args_copy);
         va_end(args_copy);
-        fprintf(stderr, "%s: %s\n", program_name_, buf);
+        reportError(buf, NULL);
     }
 }
 
@@ -57,7 +119,7 @@ void myErrorErrno(const char* restrict message, ...) {
         char buf[len+1];
         vsnprintf(buf, (size_t)len+1, message, args_copy);
         va_end(args_copy);
-        fprintf(stderr, "%s: %s: %s\n", program_name_, buf, strerror(error));
+        reportError(buf, strerror(error));
     }
 }
 
@@ -71,9 +133,9 @@ void myFatal(const char* restrict message, ...) {
         char buf[len+1];
         vsnprintf(buf, (size_t)len+1, message, args_copy);
         va_end(args_copy);
-        fprintf(stderr, "%s: %s\n", program_name_, buf);
+        reportError(buf, NULL);
     }
-    exit(EXIT_FAILURE);
+    fatalExit();
 }
 
 void myFatalErrno(const char* restrict message, ...) {
@@ -87,9 +149,9 @@ void myFatalErrno(const char* restrict message, ...) {
         char buf[len+1];
         vsnprintf(buf, (size_t)len+1, message, args_copy);
         va_end(args_copy);
-        fprintf(stderr, "%s: %s: %s\n", program_name_, buf, strerror(error));
+        reportError(buf, strerror(error));
     }
-    exit(EXIT_FAILURE);
+    fatalExit();
 }
 
 #ifdef ARRGEN_HAS_WINDOWS_ERROR_FUNCTIONS
@@ -119,7 +181,7 @@ void myErrorWindowsError(const char *restrict message, ...) {
             // SOMEHOW, it appears the buffer is UTF-8? (more likely, it's ANSI, but the same in this case)
             // TODO: figure out using other languages like Japanese (will need to install first though)
         );
-        fprintf(stderr, "%s: %s: %s\n", program_name_, buf, lp_buf); // it's annoying that I have to do this, seems I can't do it with the above if I'm using the above in an strerror-like way
+        reportError(buf, lp_buf); // it's annoying that I have to do this, seems I can't do it with the above if I'm using the above in an strerror-like way
         LocalFree(lp_buf);
     }
 }
@@ -150,11 +212,11 @@ void myFatalWindowsError(const char *restrict message, ...) {
             // SOMEHOW, it appears the buffer is UTF-8? (more likely, it's ANSI, but the same in this case)
             // TODO: figure out using other languages like Japanese (will need to install first though)
         );
-        fprintf(stderr, "%s: %s: %s\n", program_name_, buf, lp_buf); // it's annoying that I have to do this, seems I can't do it with the above if I'm using the above in an strerror-like way
+        reportError(buf, lp_buf); // it's annoying that I have to do this, seems I can't do it with the above if I'm using the above in an strerror-like way
 #ifndef NDEBUG
         LocalFree(lp_buf);
 #endif
     }
-    exit(EXIT_FAILURE);
+    fatalExit();
 }
 #endif // _WIN32 or _WIN64
\ No newline at end of file
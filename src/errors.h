@@ -19,6 +19,7 @@
 #ifndef ERRORS_H_INCLUDED
 #define ERRORS_H_INCLUDED
 #include "arrgen.h"
+#include <setjmp.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -26,6 +27,25 @@ extern "C" {
 
 extern const char* program_name_;
 
+/**
+ * @brief until stopCapturingErrors, on this thread, error messages are saved instead of printed, and fatal errors longjmp
+ * to fatal_jump instead of quitting. for libarrgen. forgets any messages saved before
+*/
+void captureErrors(jmp_buf* fatal_jump)
+    ATTR_NONNULL;
+
+/**
+ * @brief goes back to printing error messages and quitting on fatal errors
+ * @return the messages saved since captureErrors, one per line, or NULL if there weren't any. the caller frees it
+*/
+char* stopCapturingErrors(void);
+
+/**
+ * @brief cleanup is called before quitting on a fatal error (but not one captured by captureErrors), on whichever thread
+ * it happened on. only the first fatal error calls it
+*/
+void setFatalCleanup(void (*cleanup)(void));
+
 /**
  * @brief prints formatted error message and string describing meaning of errno in format (program_name: message: errno meaning) to standard error
  * @param message printf-formatted message string
@@ -57,7 +77,6 @@ void myFatalErrno(const char *restrict message, ...)
     ATTR_COLD
     ATTR_NONNULL_N(1)
     ATTR_NOTHROW
-    ATTR_LEAF
     ATTR_FORMAT(printf, 1, 2);
 
 /**
@@ -69,7 +88,6 @@ void myFatal(const char *restrict message, ...)
     ATTR_COLD
     ATTR_NONNULL_N(1)
     ATTR_NOTHROW
-    ATTR_LEAF
     ATTR_FORMAT(printf, 1, 2);
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -94,7 +112,6 @@ void myFatalWindowsError(const char *restrict message, ...)
     ATTR_COLD
     ATTR_NONNULL_N(1)
     ATTR_NOTHROW
-    ATTR_LEAF
     ATTR_FORMAT(printf, 1, 2);
 #endif // _WIN32 or _WIN64
 
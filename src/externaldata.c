@@ -0,0 +1,270 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arrgen.h"
+#include "externaldata.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+#   include <unistd.h>
+#endif
+#include "errors.h"
+#include "c_string_stuff.h"
+
+static void writeLE(FILE* out, uint64_t value, unsigned num_bytes)
+    ATTR_NONNULL;
+
+static void writeCStringEscaped(FILE* out, const char* str)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_NONNULL;
+
+static char* packPathForLoader(const OutputFileParams* params)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_MALLOC(free)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL;
+
+void startExternalPack(FILE* out, size_t num_entries) {
+    fwrite("ARRGENPK", 1, 8U, out);
+    writeLE(out, ARRGEN_EXTERNAL_VERSION, 4U);
+    writeLE(out, num_entries, 4U);
+    writeLE(out, 0U, 8U); // filled in by finishExternalPack
+}
+
+uint64_t alignExternalPack(FILE* out, uint32_t alignment) {
+    if (alignment<ARRGEN_EXTERNAL_ALIGNMENT)
+        alignment = ARRGEN_EXTERNAL_ALIGNMENT;
+    // the pack is mapped at a page boundary, so anything beyond that can't be kept anyway
+    if (alignment>arrgen_pagesize_)
+        alignment = arrgen_pagesize_;
+    long offset = ftell(out);
+    if (UNLIKELY(offset<0L))
+        myFatalErrno("ftell");
+    for (; (uint64_t)offset%alignment!=0U; offset++)
+        putc(0, out);
+    return (uint64_t)offset;
+}
+
+void finishExternalPack(FILE* out, const ExternalEntry entries[], size_t num_entries) {
+    uint64_t table_offset = alignExternalPack(out, 8U);
+    for (size_t i=0U; i<num_entries; i++) {
+        writeLE(out, entries[i].offset, 8U);
+        writeLE(out, entries[i].length, 8U);
+    }
+    if (UNLIKELY(fseek(out, 16L, SEEK_SET)!=0))
+        myFatalErrno("fseek");
+    writeLE(out, table_offset, 8U);
+    if (UNLIKELY(fseek(out, 0L, SEEK_END)!=0))
+        myFatalErrno("fseek");
+}
+
+void writeExternalDeclarations(FILE* out, const OutputFileParams* params, size_t first, size_t end) {
+    const char *name = params->external_data_name;
+    // repeated in each header with header_per_input, which is fine for prototypes
+    fprintf(out,
+        "// the contents are loaded from %s the first time one of these is called\n"
+        "const unsigned char* %s_DATA(size_t index);\n"
+        "size_t %s_LENGTH(size_t index);\n",
+        ARRGEN_BASENAME(params->external_data),
+        name,
+        name);
+    for (size_t i=first; i<end; i++) {
+        const InputFileParams *input = &params->inputs[i];
+        char *path = pathForOutput(params, input->path_original);
+        fprintf(out,
+            "\n"
+            "// %s\n"
+            "#define %s (%s_LENGTH(%zuU))\n"
+            "#define %s ((%sunsigned char*)%s_DATA(%zuU))\n",
+            path,
+            input->length_name, name, i,
+            input->array_name, (input->make_const ? "const " : ""), name, i);
+        if (input->pad_to>1U)
+            fprintf(out,
+                "#define %s_PADDED_LENGTH ((%s+%" PRIu32 "U-1U)/%" PRIu32 "U*%" PRIu32 "U)\n",
+                input->array_name,
+                input->length_name,
+                input->pad_to,
+                input->pad_to,
+                input->pad_to);
+        free(path);
+    }
+}
+
+void writeExternalLoader(FILE* out, const OutputFileParams* params) {
+    const char *name = params->external_data_name;
+    char *pack_path = packPathForLoader(params);
+    fputs(
+        "#include <stdio.h>\n"
+        "#include <stdlib.h>\n"
+        "#include <string.h>\n"
+        "#if defined(_WIN32) || defined(_WIN64)\n"
+        "#   include <windows.h>\n"
+        "#elif defined(__unix__) || defined(__APPLE__)\n"
+        "#   include <fcntl.h>\n"
+        "#   include <sys/mman.h>\n"
+        "#   include <sys/stat.h>\n"
+        "#   include <unistd.h>\n"
+        "#endif\n"
+        "\n"
+        "static unsigned char* arrgen_pack_ = NULL;\n"
+        "\n"
+        "static unsigned long long arrgenReadLE(const unsigned char* p, unsigned num_bytes) {\n"
+        "    unsigned long long ret = 0U;\n"
+        "    while (num_bytes-->0U)\n"
+        "        ret = (ret << 8) | p[num_bytes];\n"
+        "    return ret;\n"
+        "}\n"
+        "\n"
+        "static void arrgenPackError(const char* path, const char* what) {\n"
+        "    fprintf(stderr, \"%s: %s\\n\", path, what);\n"
+        "    abort();\n"
+        "}\n"
+        "\n"
+        "// mapped copy-on-write, so the arrays that aren't const can still be written to\n"
+        "static unsigned char* arrgenLoadPack(void) {\n",
+        out);
+    fprintf(out,
+        "    const char *path = getenv(\"%s_PATH\");\n"
+        "    if (path==NULL)\n"
+        "        path = \"",
+        name);
+    writeCStringEscaped(out, pack_path);
+    fprintf(out,
+        "\";\n"
+        "    unsigned char *pack = NULL;\n"
+        "    unsigned long long size = 0U;\n"
+        "#if defined(_WIN32) || defined(_WIN64)\n"
+        "    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);\n"
+        "    LARGE_INTEGER large;\n"
+        "    if (file==INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &large))\n"
+        "        arrgenPackError(path, \"could not open\");\n"
+        "    size = (unsigned long long)large.QuadPart;\n"
+        "    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);\n"
+        "    if (mapping!=NULL)\n"
+        "        pack = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);\n"
+        "    if (pack==NULL)\n"
+        "        arrgenPackError(path, \"could not map\");\n"
+        "    CloseHandle(mapping);\n"
+        "    CloseHandle(file);\n"
+        "#elif defined(__unix__) || defined(__APPLE__)\n"
+        "    int fd = open(path, O_RDONLY);\n"
+        "    struct stat stats;\n"
+        "    if (fd<0 || fstat(fd, &stats)!=0)\n"
+        "        arrgenPackError(path, \"could not open\");\n"
+        "    size = (unsigned long long)stats.st_size;\n"
+        "    if (size>0U)\n"
+        "        pack = (unsigned char*)mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);\n"
+        "    if (pack==NULL || pack==(unsigned char*)MAP_FAILED)\n"
+        "        arrgenPackError(path, \"could not map\");\n"
+        "    close(fd);\n"
+        "#else\n"
+        "    FILE *in = fopen(path, \"rb\");\n"
+        "    if (in==NULL || fseek(in, 0, SEEK_END)!=0 || (size = (unsigned long long)ftell(in))==0U || fseek(in, 0, SEEK_SET)!=0)\n"
+        "        arrgenPackError(path, \"could not open\");\n"
+        "    pack = (unsigned char*)malloc((size_t)size);\n"
+        "    if (pack==NULL || fread(pack, 1, (size_t)size, in)!=(size_t)size)\n"
+        "        arrgenPackError(path, \"could not read\");\n"
+        "    fclose(in);\n"
+        "#endif\n"
+        "    if (size<%uU || memcmp(pack, \"ARRGENPK\", 8U)!=0 || arrgenReadLE(&pack[8], 4U)!=%uU)\n"
+        "        arrgenPackError(path, \"not an arrgen pack of the right version\");\n"
+        "    if (arrgenReadLE(&pack[12], 4U)!=%zuU)\n"
+        "        arrgenPackError(path, \"has a different number of inputs than this was generated with, regenerate the code too\");\n"
+        "    const unsigned long long table_offset = arrgenReadLE(&pack[16], 8U);\n"
+        "    if (table_offset>size || (size-table_offset)/16U<%zuU)\n"
+        "        arrgenPackError(path, \"is cut off\");\n"
+        "    for (size_t i=0U; i<%zuU; i++) {\n"
+        "        const unsigned long long offset = arrgenReadLE(&pack[table_offset+i*16U], 8U);\n"
+        "        const unsigned long long length = arrgenReadLE(&pack[table_offset+i*16U+8U], 8U);\n"
+        "        if (offset>size || length>size-offset)\n"
+        "            arrgenPackError(path, \"is cut off\");\n"
+        "    }\n"
+        "    return pack;\n"
+        "}\n"
+        "\n"
+        "static unsigned char* arrgenPack(void) {\n"
+        "#if defined(__GNUC__)\n"
+        "    unsigned char *pack = __atomic_load_n(&arrgen_pack_, __ATOMIC_ACQUIRE);\n"
+        "    if (pack==NULL) {\n"
+        "        // if another thread loads it at the same time, one of the two mappings is just never used\n"
+        "        unsigned char *loaded = arrgenLoadPack();\n"
+        "        if (__atomic_compare_exchange_n(&arrgen_pack_, &pack, loaded, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))\n"
+        "            pack = loaded;\n"
+        "    }\n"
+        "    return pack;\n"
+        "#else\n"
+        "    if (arrgen_pack_==NULL)\n"
+        "        arrgen_pack_ = arrgenLoadPack();\n"
+        "    return arrgen_pack_;\n"
+        "#endif\n"
+        "}\n"
+        "\n"
+        "const unsigned char* %s_DATA(size_t index) {\n"
+        "    unsigned char *pack = arrgenPack();\n"
+        "    return &pack[arrgenReadLE(&pack[arrgenReadLE(&pack[16], 8U)+index*16U], 8U)];\n"
+        "}\n"
+        "\n"
+        "size_t %s_LENGTH(size_t index) {\n"
+        "    const unsigned char *pack = arrgenPack();\n"
+        "    return (size_t)arrgenReadLE(&pack[arrgenReadLE(&pack[16], 8U)+index*16U+8U], 8U);\n"
+        "}\n",
+        ARRGEN_EXTERNAL_HEADER_SIZE,
+        ARRGEN_EXTERNAL_VERSION,
+        params->num_inputs,
+        params->num_inputs,
+        params->num_inputs,
+        name,
+        name);
+    free(pack_path);
+}
+
+static void writeLE(FILE* out, uint64_t value, unsigned num_bytes) {
+    for (unsigned i=0U; i<num_bytes; i++)
+        putc((int)((value >> (8U*i)) & 0xFFU), out);
+}
+
+static void writeCStringEscaped(FILE* out, const char* str) {
+    for (; *str!='\0'; str++) {
+        if (*str=='"' || *str=='\\')
+            putc('\\', out);
+        putc(*str, out);
+    }
+}
+
+// the loader is run from wherever the program is, so it needs an absolute path. except in reproducible mode, where the
+// path in the output can't depend on where the build is, so it's up to the environment variable then
+static char* packPathForLoader(const OutputFileParams* params) {
+    if (params->reproducible || params->external_data[0]=='/')
+        return pathForOutput(params, params->external_data);
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+    char *cwd = getcwd(NULL, 0U);
+    if (LIKELY(cwd!=NULL)) {
+        char *ret = sprintfAppend(NULL, "%s/%s", cwd, params->external_data);
+        free(cwd);
+        return ret;
+    }
+    myErrorErrno("getcwd");
+#elif defined(_WIN32) || defined(_WIN64)
+    char *ret = _fullpath(NULL, params->external_data, 0U);
+    if (LIKELY(ret!=NULL))
+        return ret;
+#endif
+    return duplicateString(params->external_data);
+}
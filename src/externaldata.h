@@ -0,0 +1,82 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXTERNALDATA_H_INCLUDED
+#define EXTERNALDATA_H_INCLUDED
+#include "arrgen.h"
+#include <stdio.h>
+#include "handlefile.h"
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// With external_data, the inputs go in a pack file instead of the .c file, which becomes a small loader that maps the pack
+// the first time anything in it is used. The pack is:
+//   "ARRGENPK", a 32-bit version and a 32-bit number of entries, then a 64-bit offset of the entry table
+//   the contents of each input, each starting at a multiple of ARRGEN_EXTERNAL_ALIGNMENT (or its alignment, if bigger)
+//   the entry table: a 64-bit offset and length for each input, in the same order as the inputs
+// with every number little-endian. The offsets and lengths are only in the pack, so changing an input only changes the pack
+#define ARRGEN_EXTERNAL_VERSION 1U
+#define ARRGEN_EXTERNAL_HEADER_SIZE 24U
+#define ARRGEN_EXTERNAL_ALIGNMENT 64U
+
+// where an input went in the pack
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+} ExternalEntry;
+
+/**
+ * @brief writes the header of the pack, with room for the table offset to be filled in by finishExternalPack
+*/
+void startExternalPack(FILE* out, size_t num_entries)
+    ATTR_NONNULL;
+
+/**
+ * @brief writes zeros up to the next offset an input with this alignment can start at
+ * @return the offset the input starts at
+*/
+uint64_t alignExternalPack(FILE* out, uint32_t alignment)
+    ATTR_NONNULL;
+
+/**
+ * @brief writes the entry table at the end of the pack, and its offset in the header. out must be seekable
+*/
+void finishExternalPack(FILE* out, const ExternalEntry entries[], size_t num_entries)
+    ATTR_ACCESS(read_only, 2, 3)
+    ATTR_NONNULL;
+
+/**
+ * @brief writes the definitions of the loader functions declared by writeExternalDeclarations, after the #include of the header
+*/
+void writeExternalLoader(FILE* out, const OutputFileParams* params)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_NONNULL;
+
+/**
+ * @brief writes the declarations of the loader functions, and the macros for the arrays and lengths that call them, in place of
+ * the usual declarations
+*/
+void writeExternalDeclarations(FILE* out, const OutputFileParams* params, size_t first, size_t end)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_NONNULL;
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // EXTERNALDATA_H_INCLUDED
@@ -0,0 +1,150 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arrgen.h"
+#include "fragmentcache.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+#   include <sys/stat.h>
+#   include <unistd.h>
+#   include <fcntl.h>
+#elif defined(_WIN32) || defined(_WIN64)
+#   include <direct.h>
+#endif
+#include "errors.h"
+#include "hash.h"
+#include "writearray.h"
+#include "outputfile.h"
+#include "c_string_stuff.h"
+
+// bump this whenever writeArrayContents changes what it writes, so old cache entries stop matching
+#define ARRGEN_FRAGMENT_VERSION 1U
+
+static bool copyFileContents(FILE* out, FILE* in, const char* in_path)
+    ATTR_ACCESS(read_only, 3)
+    ATTR_NONNULL;
+
+bool prepareFragmentCache(const char* cache_dir) {
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+    int res = mkdir(cache_dir, 0777);
+#elif defined(_WIN32) || defined(_WIN64)
+    int res = _mkdir(cache_dir);
+#else
+    // no portable way to make a directory, so it will have to exist already
+    int res = 0;
+#endif
+    if (UNLIKELY(res!=0 && errno!=EEXIST)) {
+        myErrorErrno("%s: could not create cache directory", cache_dir);
+        return false;
+    }
+    return true;
+}
+
+void writeArrayContentsCached(FILE* out, const char* cache_dir, const uint8_t *buf, size_t length, uint8_t base, bool aligned, size_t line_limit, bool check_only) {
+    Xxh64State state;
+    xxh64Init(&state, 0U);
+    xxh64Update(&state, buf, length);
+    // the length is in the name too, to make a collision that much less likely
+    char *path = sprintfAppend(NULL, "%s/%016" PRIx64 "-%zu-b%u%s-l%zu.v%u",
+        cache_dir,
+        xxh64Digest(&state),
+        length,
+        (unsigned)base,
+        (aligned ? "a" : ""),
+        line_limit,
+        ARRGEN_FRAGMENT_VERSION);
+    FILE *cached = fopen(path, "rb");
+    if (cached==NULL && check_only) {
+        // --check doesn't write anything, the cache included
+        DLOG("%s: cache miss, not filling it when only checking", path);
+        free(path);
+        ssize_t cur_line_pos = -1;
+        writeArrayContents(out, buf, length, &cur_line_pos, line_limit);
+        return;
+    }
+    if (cached==NULL) {
+        DLOG("%s: cache miss", path);
+        // going through a temporary file means another arrgen process reading the cache at the same time never sees half of an entry
+        OutputFile output;
+        FILE *entry = openOutputFile(&output, path, false);
+        if (LIKELY(entry!=NULL)) {
+            ssize_t cur_line_pos = -1;
+            writeArrayContents(entry, buf, length, &cur_line_pos, line_limit);
+            if (LIKELY(closeOutputFile(&output, true)))
+                cached = fopen(path, "rb");
+        }
+    }
+    if (LIKELY(cached!=NULL)) {
+        bool copied = copyFileContents(out, cached, path);
+        fclose(cached);
+        // part of it might have been written already, so there's no falling back from here
+        if (UNLIKELY(!copied))
+            myFatal("%s: could not copy cached fragment", path);
+        free(path);
+        return;
+    }
+    // the cache not working is no reason to not generate the output
+    myErrorErrno("%s: could not use cache entry, formatting without the cache", path);
+    free(path);
+    ssize_t cur_line_pos = -1;
+    writeArrayContents(out, buf, length, &cur_line_pos, line_limit);
+}
+
+static bool copyFileContents(FILE* out, FILE* in, const char* in_path) {
+#if defined(__linux__) && defined(__GLIBC__)
+    // let the kernel do the copy (or even share the blocks, on filesystems that support reflinks).
+    // falls back on copying through a buffer if the two files don't support it, eg if out is a pipe
+    if (LIKELY(fflush(out)==0)) {
+        ssize_t num_copied;
+        bool any_copied = false;
+        while ((num_copied = copy_file_range(fileno(in), NULL, fileno(out), NULL, 1U<<30, 0U)) > 0)
+            any_copied = true;
+        if (num_copied==0)
+            return true;
+        if (UNLIKELY(any_copied)) {
+            myErrorErrno("%s: copy_file_range", in_path);
+            return false;
+        }
+        DLOG("%s: copy_file_range failed (%s), trying splice", in_path, strerror(errno));
+        // which works when out is a pipe, eg when the .c file is going to stdout
+        while ((num_copied = splice(fileno(in), NULL, fileno(out), NULL, 1U<<30, SPLICE_F_MORE)) > 0)
+            any_copied = true;
+        if (num_copied==0)
+            return true;
+        if (UNLIKELY(any_copied)) {
+            myErrorErrno("%s: splice", in_path);
+            return false;
+        }
+        DLOG("%s: splice failed (%s), copying through a buffer", in_path, strerror(errno));
+    }
+#endif
+    uint8_t buf[ARRGEN_BUFFER_SIZE];
+    size_t num_read;
+    do {
+        num_read = fread(buf, 1, ARRGEN_BUFFER_SIZE, in);
+        if (UNLIKELY(fwrite(buf, 1, num_read, out)!=num_read))
+            return false;
+    } while (num_read==ARRGEN_BUFFER_SIZE);
+    if (UNLIKELY(ferror(in))) {
+        myErrorErrno("%s: read", in_path);
+        return false;
+    }
+    return true;
+}
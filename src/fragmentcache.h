@@ -0,0 +1,53 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAGMENTCACHE_H_INCLUDED
+#define FRAGMENTCACHE_H_INCLUDED
+#include "arrgen.h"
+#include <stdio.h>
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * @brief creates the cache directory if it doesn't exist yet. prints an error message on failure
+*/
+bool prepareFragmentCache(const char* cache_dir)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_NONNULL;
+
+/**
+ * @brief does the same thing as calling writeArrayContents once for the whole array, but keeps a copy of the text in cache_dir,
+ * keyed by the hash of buf and the formatting settings, and copies that instead of formatting again if it's already there.
+ * initializeLookup must have been called with the same base and aligned first.
+ * Nothing is ever deleted from the cache, that's up to the user.
+ * @param out the file to write to
+ * @param cache_dir the directory to keep the formatted text in
+ * @param buf the bytes to turn into text
+ * @param length the number of bytes in buf
+ * @param check_only use entries that are already there, but don't add any
+*/
+void writeArrayContentsCached(FILE* out, const char* cache_dir, const uint8_t *buf, size_t length, uint8_t base, bool aligned, size_t line_limit, bool check_only)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(read_only, 3, 4)
+    ATTR_NONNULL;
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // FRAGMENTCACHE_H_INCLUDED
@@ -40,43 +40,394 @@
 #include "errors.h"
 #include "writearray.h"
 #include "c_string_stuff.h"
+#include "outputfile.h"
+#include "fragmentcache.h"
+#include "hash.h"
+#include "transform.h"
+#include "externaldata.h"
+#include "stats.h"
+#include "trace.h"
 
-static bool writeH(const OutputFileParams* params, const size_t lengths[])
+typedef struct {
+    size_t length;
+    size_t num_chunks; // 0 if the input was written as a single array, otherwise the number of chunk arrays it was split into
+    uint32_t crc32c; // only set if the input's checksums include them
+    uint64_t xxh64;
+} OutputArrayInfo;
+
+// the checksums of an input, computed a piece at a time as it's formatted
+typedef struct {
+    uint8_t which; // ARRGEN_CHECKSUM_* flags
+    uint32_t crc32c;
+    Xxh64State xxh64;
+} ChecksumState;
+
+static bool writeH(const OutputFileParams* params, OutputArrayInfo infos[])
+    ATTR_ACCESS(read_only, 1)
+    ATTR_NONNULL;
+
+static bool writeHeaderFile(const OutputFileParams* params, const char* h_path, OutputArrayInfo infos[], size_t first, size_t end, const char* included_stem)
     ATTR_ACCESS(read_only, 1)
     ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(read_only, 6)
+    ATTR_NONNULL_N(1)
+    ATTR_NONNULL_N(2)
+    ATTR_NONNULL_N(3);
+
+static void writeChecksums(FILE* out, const OutputFileParams* params, const InputFileParams *input, const OutputArrayInfo *info, bool in_header)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(read_only, 3)
+    ATTR_ACCESS(read_only, 4)
+    ATTR_NONNULL;
+
+static void writeDeclarations(FILE* out, const OutputFileParams* params, const OutputArrayInfo infos[], size_t first, size_t end)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(read_only, 3)
     ATTR_NONNULL;
 
-static bool writeC(const OutputFileParams* params, size_t lengths[])
+static bool writeConstexprDefinitions(FILE* out, const OutputFileParams* params, OutputArrayInfo infos[], size_t first, size_t end)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(write_only, 3)
+    ATTR_NONNULL;
+
+static bool anyChecksums(const OutputFileParams* params, size_t first, size_t end)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_PURE
+    ATTR_NONNULL;
+
+static char* includeGuardFromNames(const OutputFileParams* params, const char* h_path, size_t first, size_t end)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_MALLOC(free)
+    ATTR_NONNULL
+    ATTR_RETURNS_NONNULL;
+
+static bool writeC(const OutputFileParams* params, OutputArrayInfo infos[])
     ATTR_ACCESS(read_only, 1)
     ATTR_ACCESS(write_only, 2)
     ATTR_NONNULL;
 
-static ssize_t writeArrayStreamed(FILE* out, FILE* in, const char* in_path, size_t line_limit)
+static bool writeExternal(const OutputFileParams* params, OutputArrayInfo infos[])
+    ATTR_ACCESS(read_only, 1)
     ATTR_NONNULL;
 
-static ssize_t writeFileContents(FILE* out, const InputFileParams *input)
+static bool writeCFile(const OutputFileParams* params, const char* path, const size_t shard_of[], size_t shard, OutputArrayInfo infos[])
+    ATTR_ACCESS(read_only, 1)
     ATTR_ACCESS(read_only, 2)
+    ATTR_NONNULL_N(1)
+    ATTR_NONNULL_N(2)
+    ATTR_NONNULL_N(5);
+
+static void assignShards(const OutputFileParams* params, size_t shard_of[])
+    ATTR_ACCESS(read_only, 1)
+    ATTR_ACCESS(write_only, 2)
+    ATTR_NONNULL;
+
+// an input and its size, for sorting the inputs by size when assigning shards
+typedef struct {
+    size_t size;
+    size_t index;
+} SizedInput;
+
+static int compareSizedInputs(const void* a, const void* b)
+    ATTR_PURE
+    ATTR_NONNULL;
+
+static size_t inputSize(const InputFileParams *input)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_NONNULL;
+
+static void recordGeneratedFile(const char* path)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_NONNULL;
+
+static void forgetGeneratedFiles(void);
+
+static bool writeOutputList(const char* path, bool check_only)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_NONNULL;
+
+static bool writeDepfile(const OutputFileParams* params)
+    ATTR_ACCESS(read_only, 1)
     ATTR_NONNULL;
 
+static void writeMakeEscaped(FILE* out, const char* path)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_NONNULL;
+
+static char* headerNameForInput(const OutputFileParams* params, const InputFileParams *input)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_MALLOC(free)
+    ATTR_NONNULL
+    ATTR_RETURNS_NONNULL;
+
+static void writeArrayStart(FILE* out, const OutputFileParams* params, const InputFileParams *input)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(read_only, 3)
+    ATTR_NONNULL;
+
+static bool writeArrayFromMemory(FILE* out, const OutputFileParams* params, const InputFileParams *input, const uint8_t* mem, size_t length, OutputArrayInfo *info)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(read_only, 3)
+    ATTR_ACCESS(read_only, 4, 5)
+    ATTR_ACCESS(write_only, 6)
+    ATTR_NONNULL;
+
+static void writeArrayContentsFromMemory(FILE* out, const OutputFileParams* params, const InputFileParams *input, const uint8_t* mem, size_t length, ChecksumState* checksums)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(read_only, 3)
+    ATTR_ACCESS(read_only, 4, 5)
+    ATTR_ACCESS(read_write, 6)
+    ATTR_NONNULL;
+
+static bool writeArraySplit(FILE* out, const OutputFileParams* params, const InputFileParams *input, const uint8_t* mem, size_t length, OutputArrayInfo *info, ChecksumState* checksums)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(read_only, 3)
+    ATTR_ACCESS(read_only, 4, 5)
+    ATTR_ACCESS(write_only, 6)
+    ATTR_ACCESS(read_write, 7)
+    ATTR_NONNULL;
+
+static ssize_t writeArrayStreamed(FILE* out, FILE* in, const OutputFileParams* params, const InputFileParams *input, OutputArrayInfo *info)
+    ATTR_ACCESS(read_only, 3)
+    ATTR_ACCESS(read_only, 4)
+    ATTR_ACCESS(write_only, 5)
+    ATTR_NONNULL;
+
+static void startChecksums(ChecksumState* checksums, uint8_t which)
+    ATTR_ACCESS(write_only, 1)
+    ATTR_NONNULL;
+
+static void updateChecksums(ChecksumState* checksums, const uint8_t* buf, size_t length)
+    ATTR_ACCESS(read_write, 1)
+    ATTR_ACCESS(read_only, 2, 3)
+    ATTR_NONNULL_N(1);
+
+static void finishChecksums(const ChecksumState* checksums, OutputArrayInfo *info)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_ACCESS(read_write, 2)
+    ATTR_NONNULL;
+
+static bool writeInput(FILE* out, const OutputFileParams* params, size_t index, OutputArrayInfo *info)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(write_only, 4)
+    ATTR_NONNULL;
+
+static bool writeFileContents(FILE* out, const OutputFileParams* params, const InputFileParams *input, OutputArrayInfo *info)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(read_only, 3)
+    ATTR_ACCESS(write_only, 4)
+    ATTR_NONNULL;
+
+static bool writeArchiveMember(FILE* out, const OutputFileParams* params, const InputFileParams *input, OutputArrayInfo *info)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(read_only, 3)
+    ATTR_ACCESS(write_only, 4)
+    ATTR_NONNULL;
+
+static void unmapArchive(void);
+
+// every file written, in the order they were written, for output_list
+static ARRGEN_THREAD_LOCAL char **generated_files_ = NULL;
+static ARRGEN_THREAD_LOCAL size_t num_generated_files_ = 0U;
+
+// the tar archive the last archive member was written from. it stays mapped until handleFile is done, since an archive's members
+// are usually all next to each other in the inputs, so the archive only has to be opened and mapped once
+typedef struct {
+    char* path; // NULL if nothing is mapped
+    const uint8_t* mem;
+    size_t length;
+} MappedArchive;
+
+static ARRGEN_THREAD_LOCAL MappedArchive mapped_archive_ = {
+    .path = NULL,
+};
+
+// what handleFile has allocated or open at the moment, which a fatal error in libarrgen would otherwise leak.
+// abandonHandleFile cleans it up, and so does the next handleFile on the same thread
+static ARRGEN_THREAD_LOCAL OutputArrayInfo *infos_ = NULL;
+static ARRGEN_THREAD_LOCAL const uint8_t *mapped_input_ = NULL;
+static ARRGEN_THREAD_LOCAL size_t mapped_input_length_ = 0U;
+static ARRGEN_THREAD_LOCAL FILE *input_file_ = NULL;
+
+#ifdef ARRGEN_WATCH_SUPPORTED
+// the text written for each input the last time, for watch mode. only used with a single settings file, so not thread-local
+typedef struct {
+    char* text; // NULL if there's nothing remembered
+    size_t text_length;
+    OutputArrayInfo info;
+} RememberedArray;
+
+static RememberedArray *remembered_ = NULL;
+static size_t num_remembered_ = 0U;
+
+void rememberArrays(size_t num_inputs) {
+    for (size_t i=0U; i<num_remembered_; i++)
+        free(remembered_[i].text);
+    free(remembered_);
+    remembered_ = NULL;
+    num_remembered_ = num_inputs;
+    if (num_inputs>0U) {
+        remembered_ = calloc(num_inputs, sizeof(RememberedArray));
+        if (UNLIKELY(remembered_==NULL))
+            myFatalErrno("failed to allocate %zu bytes", sizeof(RememberedArray)*num_inputs);
+    }
+}
+
+void forgetArray(size_t index) {
+    if (index<num_remembered_) {
+        free(remembered_[index].text);
+        remembered_[index].text = NULL;
+    }
+}
+#endif // ARRGEN_WATCH_SUPPORTED
+
 bool handleFile(const OutputFileParams* params) {
-    size_t lengths[params->num_inputs];
-    return writeC(params, lengths) && (!params->create_header || writeH(params, lengths));
+    // anything left from a call that was cut short by a fatal error in libarrgen
+    abandonHandleFile();
+    // not on the stack, there could be any number of inputs. zeroed, since with check_only the header is still compared
+    // after an input failed, and it shouldn't be made from garbage
+    OutputArrayInfo *infos = infos_ = calloc(params->num_inputs+1U, sizeof(OutputArrayInfo));
+    if (UNLIKELY(infos==NULL))
+        myFatalErrno("failed to allocate %zu bytes", sizeof(OutputArrayInfo)*(params->num_inputs+1U));
+    // --check only reads the cache, so it doesn't need to create the directory either
+    bool ret = (params->cache_dir==NULL || params->check_only || prepareFragmentCache(params->cache_dir));
+    // with check_only every output is compared even once one has turned out to be out of date, so they all get reported
+    const bool keep_going = params->check_only;
+    // with cpp_constexpr the arrays are written into the header, so there's no .c file at all
+    if (params->cpp_constexpr) {
+        if (ret || keep_going)
+            ret = writeH(params, infos) && ret;
+    } else {
+        if (ret || keep_going)
+            ret = writeC(params, infos) && ret;
+        if (params->create_header && (ret || keep_going))
+            ret = writeH(params, infos) && ret;
+    }
+    if (params->output_list!=NULL && (ret || keep_going))
+        ret = writeOutputList(params->output_list, params->check_only) && ret;
+    if (params->depfile!=NULL && (ret || keep_going))
+        ret = writeDepfile(params) && ret;
+    abandonHandleFile();
+    return ret;
 }
 
-static bool writeH(const OutputFileParams* params, const size_t lengths[]) {
-    DLOG("entering function");
+void abandonHandleFile(void) {
+    abandonOutputFiles();
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+    if (mapped_input_!=NULL && UNLIKELY(munmap((void*)mapped_input_, mapped_input_length_)!=0))
+        myErrorErrno("munmap");
+#endif
+    mapped_input_ = NULL;
+    if (input_file_!=NULL)
+        fclose(input_file_);
+    input_file_ = NULL;
+    free(infos_);
+    infos_ = NULL;
+    forgetGeneratedFiles();
+    unmapArchive();
+}
+
+static void forgetGeneratedFiles(void) {
+    for (size_t i=0U; i<num_generated_files_; i++)
+        free(generated_files_[i]);
+    free(generated_files_);
+    generated_files_ = NULL;
+    num_generated_files_ = 0U;
+}
+
+static bool writeH(const OutputFileParams* params, OutputArrayInfo infos[]) {
     // this is a clunky way of handling it, but whatever
     const char *h_path = pathRelativeToFile(params->c_path, params->h_name);
-    FILE *out = fopen(h_path, "wb");
     bool ret;
-    if (UNLIKELY(out==NULL)) {
-        myErrorErrno("%s: could not open", h_path);
+    if (params->header_per_input) {
+        char *stem = pathWithoutExtension(h_path);
+        ret = true;
+        for (size_t i=0U; (ret || params->check_only) && i<params->num_inputs; i++) {
+            // module interface units have no one standard extension, so the partitions get whichever one the primary has
+            char *input_h_path = sprintfAppend(NULL, "%s.%s%s", stem, params->inputs[i].array_name, (params->module_name!=NULL ? &h_path[strlen(stem)] : ".h"));
+            ret = writeHeaderFile(params, input_h_path, infos, i, i+1U, NULL) && ret;
+            free(input_h_path);
+        }
+        // the per-input headers are next to the main one, so it includes them by their base names
+        if (ret || params->check_only)
+            ret = writeHeaderFile(params, h_path, infos, 0U, params->num_inputs, ARRGEN_BASENAME(stem)) && ret;
+        free(stem);
+    } else
+        ret = writeHeaderFile(params, h_path, infos, 0U, params->num_inputs, NULL);
+    free((void*)h_path);
+    DLOG("returning %hhu", ret);
+    return (ret);
+}
+
+static bool writeHeaderFile(const OutputFileParams* params, const char* h_path, OutputArrayInfo infos[], size_t first, size_t end, const char* included_stem) {
+    DLOG("entering function: %s", h_path);
+    const double trace_start = traceNow();
+    recordGeneratedFile(h_path);
+    OutputFile output;
+    FILE *out = openOutputFile(&output, h_path, params->check_only);
+    bool ret = true;
+    if (UNLIKELY(out==NULL))
         ret = false;
+    else if (params->module_name!=NULL) {
+        // with header_per_input, each input is a partition named after its array, and the primary interface just re-exports them
+        const bool partition = (params->header_per_input && included_stem==NULL);
+        if (included_stem==NULL)
+            fprintf(out,
+                "module;\n"
+                "#include <cstddef>\n"
+                "#include <span>\n"
+                "%s"
+                "%s",
+                (anyChecksums(params, first, end) ? "#include <cstdint>\n" : ""),
+                (params->header_top_text==NULL ? "" : params->header_top_text));
+        fprintf(out,
+            "export module %s%s%s;\n"
+            "\n",
+            params->module_name,
+            (partition ? ":" : ""),
+            (partition ? params->inputs[first].array_name : ""));
+        if (included_stem!=NULL)
+            for (size_t i=first; i<end; i++)
+                fprintf(out, "export import :%s;\n", params->inputs[i].array_name);
+        else {
+            fprintf(out, "export {\n\n");
+            ret = writeConstexprDefinitions(out, params, infos, first, end);
+            fprintf(out, "}\n");
+        }
+        ret = closeOutputFile(&output, ret);
+    } else if (params->cpp_constexpr) {
+        // C++ only, so no extern "C", and the header has the definitions too
+        const char *include_guard = (params->reproducible ? includeGuardFromNames(params, h_path, first, end) : createCName(h_path, strlen(h_path), "_INCLUDED"));
+        fprintf(out,
+            "#ifndef %s\n"
+            "#define %s\n"
+            "%s"
+            "%s"
+            "%s"
+            "\n",
+            include_guard,
+            include_guard,
+            (included_stem==NULL ? "#include <cstddef>\n#if __cplusplus >= 202002L\n#include <span>\n#endif\n" : ""),
+            (included_stem==NULL && anyChecksums(params, first, end) ? "#include <cstdint>\n" : ""),
+            (included_stem!=NULL || params->header_top_text==NULL ? "" : params->header_top_text));
+        if (included_stem!=NULL)
+            for (size_t i=first; i<end; i++)
+                fprintf(out, "#include \"%s.%s.h\"\n", included_stem, params->inputs[i].array_name);
+        else
+            ret = writeConstexprDefinitions(out, params, infos, first, end);
+        fprintf(out,
+            "\n"
+            "#endif // %s\n",
+            include_guard);
+        ret = closeOutputFile(&output, ret);
+        free((void*)include_guard);
     } else {
         // TODO: fail gracefully if any fprintf fails
-        const char *include_guard = createCName(h_path, strlen(h_path), "_INCLUDED");
-        int res;
-        res = fprintf(out,
+        const char *include_guard = (params->reproducible ? includeGuardFromNames(params, h_path, first, end) : createCName(h_path, strlen(h_path), "_INCLUDED"));
+        fprintf(out,
+            "%s"
             "%s"
             "#ifndef %s\n"
             "#define %s\n"
@@ -85,104 +436,765 @@ static bool writeH(const OutputFileParams* params, const size_t lengths[]) {
             "extern \"C\" {\n"
             "#endif // __cplusplus\n"
             "\n",
-            (params->constexpr_length ? "#include <stddef.h>\n" : ""),
+            (included_stem==NULL && (params->constexpr_length || params->extern_length || params->external_data!=NULL) ? "#include <stddef.h>\n" : ""),
+            (included_stem==NULL && (params->constexpr_length || params->extern_length) && anyChecksums(params, first, end) ? "#include <stdint.h>\n" : ""),
             include_guard,
             include_guard,
-            (params->header_top_text==NULL ? "" : params->header_top_text));
-        for (size_t i=0; i<params->num_inputs; i++) {
+            (included_stem!=NULL || params->header_top_text==NULL ? "" : params->header_top_text));
+        if (included_stem!=NULL)
+            for (size_t i=first; i<end; i++)
+                fprintf(out, "#include \"%s.%s.h\"\n", included_stem, params->inputs[i].array_name);
+        else
+            writeDeclarations(out, params, infos, first, end);
+        fprintf(out,
+            "\n"
+            "#ifdef __cplusplus\n"
+            "}\n"
+            "#endif // __cplusplus\n"
+            "#endif // %s\n",
+            include_guard);
+        ret = closeOutputFile(&output, true);
+        free((void*)include_guard); // totally unnecessary but why not
+    }
+    traceSpan("header", h_path, trace_start);
+    DLOG("returning %hhu", ret);
+    return (ret);
+}
+
+// next to the lengths, and like them, they're defined in the .c files with extern_length so the header doesn't change with the inputs
+static void writeChecksums(FILE* out, const OutputFileParams* params, const InputFileParams *input, const OutputArrayInfo *info, bool in_header) {
+    if (input->checksums & ARRGEN_CHECKSUM_CRC32C) {
+        if (params->extern_length)
+            fprintf(out, (in_header ? "extern const uint32_t %s_CRC32C;\n" : "const uint32_t %s_CRC32C = 0x%08" PRIX32 "U;\n"), input->array_name, info->crc32c);
+        else
+            fprintf(out,
+                (params->constexpr_length ? "%sconstexpr uint32_t %s_CRC32C = 0x%08" PRIX32 "U;\n" : "%s#define %s_CRC32C 0x%08" PRIX32 "U\n"),
+                (params->cpp_constexpr ? "inline " : ""),
+                input->array_name,
+                info->crc32c);
+    }
+    if (input->checksums & ARRGEN_CHECKSUM_XXH64) {
+        if (params->extern_length)
+            fprintf(out, (in_header ? "extern const uint64_t %s_XXH64;\n" : "const uint64_t %s_XXH64 = 0x%016" PRIX64 "ULL;\n"), input->array_name, info->xxh64);
+        else
+            fprintf(out,
+                (params->constexpr_length ? "%sconstexpr uint64_t %s_XXH64 = 0x%016" PRIX64 "ULL;\n" : "%s#define %s_XXH64 0x%016" PRIX64 "ULL\n"),
+                (params->cpp_constexpr ? "inline " : ""),
+                input->array_name,
+                info->xxh64);
+    }
+}
+
+static void writeDeclarations(FILE* out, const OutputFileParams* params, const OutputArrayInfo infos[], size_t first, size_t end) {
+    if (params->external_data!=NULL) {
+        writeExternalDeclarations(out, params, first, end);
+        for (size_t i=first; i<end; i++)
+            writeChecksums(out, params, &params->inputs[i], &infos[i], true);
+        return;
+    }
+    // with extern_length, nothing written here depends on the sizes of the inputs, only their names
+    for (size_t i=first; i<end; i++) {
+        if (params->extern_length)
+            fprintf(out,
+                "extern const size_t %s;\n",
+                params->inputs[i].length_name);
+        else
             fprintf(out,
                 (params->constexpr_length ? "constexpr size_t %s = %" PRIu64 "U;\n" : "#define %s %" PRIu64 "U\n"),
                 params->inputs[i].length_name,
-                (uint64_t)lengths[i]);
+                (uint64_t)infos[i].length);
+        if (params->inputs[i].pad_to>1U) {
+            if (params->extern_length)
+                fprintf(out,
+                    "extern const size_t %s_PADDED_LENGTH;\n",
+                    params->inputs[i].array_name);
+            else
+                fprintf(out,
+                    (params->constexpr_length ? "constexpr size_t %s_PADDED_LENGTH = %" PRIu64 "U;\n" : "#define %s_PADDED_LENGTH %" PRIu64 "U\n"),
+                    params->inputs[i].array_name,
+                    (uint64_t)paddedLength(&params->inputs[i], infos[i].length));
         }
-        for (size_t i=0; i<params->num_inputs; i++) {
-            // TODO hmm, what do I do if the input file name contains a newline
-            // TODO use the line pragma for attributes etc...? maybe unnecessary
+        writeChecksums(out, params, &params->inputs[i], &infos[i], true);
+        if (infos[i].num_chunks!=0U) {
+            // the chunk size is a setting, not something that depends on the input, so it can stay a constant
+            fprintf(out,
+                (params->constexpr_length ? "constexpr size_t %s_CHUNK_SIZE = %" PRIu32 "U;\n" : "#define %s_CHUNK_SIZE %" PRIu32 "U\n"),
+                params->inputs[i].array_name,
+                params->inputs[i].split_size);
+            if (params->extern_length)
+                fprintf(out,
+                    "extern const size_t %s_NUM_CHUNKS;\n",
+                    params->inputs[i].array_name);
+            else
+                fprintf(out,
+                    (params->constexpr_length ? "constexpr size_t %s_NUM_CHUNKS = %" PRIu64 "U;\n" : "#define %s_NUM_CHUNKS %" PRIu64 "U\n"),
+                    params->inputs[i].array_name,
+                    (uint64_t)infos[i].num_chunks);
+        }
+    }
+    for (size_t i=first; i<end; i++) {
+        // TODO hmm, what do I do if the input file name contains a newline
+        // TODO use the line pragma for attributes etc...? maybe unnecessary
+        char *path = pathForOutput(params, params->inputs[i].path_original);
+        if (infos[i].num_chunks!=0U) {
+            // the attributes were put on the chunk arrays themselves, not on the table of pointers to them
             fprintf(out,
                 "\n"
                 "// %s\n"
-                "%s"
-                "extern%s unsigned char %s[%s];\n",
-                params->inputs[i].path_original,
-                (params->inputs[i].attributes==NULL ? "" : params->inputs[i].attributes),
+                "extern%s unsigned char* const %s_CHUNKS[%s%s];\n",
+                path,
                 (LIKELY(params->inputs[i].make_const) ? " const" : ""),
                 params->inputs[i].array_name,
-                params->inputs[i].length_name);
+                (params->extern_length ? "" : params->inputs[i].array_name),
+                (params->extern_length ? "" : "_NUM_CHUNKS"));
+        } else {
+            fprintf(out,
+                "\n"
+                "// %s\n"
+                "%s",
+                path,
+                (params->inputs[i].attributes==NULL ? "" : params->inputs[i].attributes));
+            writeArrayPlacement(out, &params->inputs[i], params->inputs[i].array_name, false);
+            fprintf(out,
+                "extern%s unsigned char %s[%s%s];\n",
+                (LIKELY(params->inputs[i].make_const) ? " const" : ""),
+                params->inputs[i].array_name,
+                (params->extern_length ? "" : (params->inputs[i].pad_to>1U ? params->inputs[i].array_name : params->inputs[i].length_name)),
+                (!params->extern_length && params->inputs[i].pad_to>1U ? "_PADDED_LENGTH" : ""));
         }
+        free(path);
+    }
+}
+
+// inline so there's one copy of each array in the program however many files include the header, and only if one of them
+// actually needs the array in memory rather than just some constant read out of it
+static bool writeConstexprDefinitions(FILE* out, const OutputFileParams* params, OutputArrayInfo infos[], size_t first, size_t end) {
+    for (size_t i=first; i<end; i++) {
+        const InputFileParams *input = &params->inputs[i];
+        char *path = pathForOutput(params, input->path_original);
         fprintf(out,
-            "\n"
-            "#ifdef __cplusplus\n"
-            "}\n"
-            "#endif // __cplusplus\n"
-            "#endif // %s\n",
-            include_guard);
-        if (UNLIKELY(ferror(out))) {
-            // TODO
+            "// %s\n"
+            "%s",
+            path,
+            (input->attributes==NULL ? "" : input->attributes));
+        free(path);
+        if (UNLIKELY(!writeInput(out, params, i, &infos[i])))
+            return false;
+        // after the array rather than before it like in the .c files, since the length isn't known until the whole input is read
+        fprintf(out,
+            "inline constexpr std::size_t %s = %" PRIu64 "U;\n",
+            input->length_name,
+            (uint64_t)infos[i].length);
+        if (input->pad_to>1U)
+            fprintf(out,
+                "inline constexpr std::size_t %s_PADDED_LENGTH = %" PRIu64 "U;\n",
+                input->array_name,
+                (uint64_t)paddedLength(input, infos[i].length));
+        writeChecksums(out, params, input, &infos[i], true);
+        fprintf(out,
+            "#if __cplusplus >= 202002L\n"
+            "inline constexpr std::span<const unsigned char, %s> %s_SPAN{%s, %s};\n"
+            "#endif\n"
+            "\n",
+            input->length_name,
+            input->array_name,
+            input->array_name,
+            input->length_name);
+    }
+    return true;
+}
+
+static bool anyChecksums(const OutputFileParams* params, size_t first, size_t end) {
+    for (size_t i=first; i<end; i++)
+        if (params->inputs[i].checksums!=0U)
+            return true;
+    return false;
+}
+
+// the header's path depends on where the build directory is, so in reproducible mode the guard comes from the header's
+// base name and the names declared in it, which are unique enough since two headers declaring the same names can't be used together anyway
+static char* includeGuardFromNames(const OutputFileParams* params, const char* h_path, size_t first, size_t end) {
+    Xxh64State state;
+    xxh64Init(&state, 0U);
+    for (size_t i=first; i<end; i++) {
+        // including the null terminators so the boundaries between names count too
+        xxh64Update(&state, (const uint8_t*)params->inputs[i].array_name, strlen(params->inputs[i].array_name)+1U);
+        xxh64Update(&state, (const uint8_t*)params->inputs[i].length_name, strlen(params->inputs[i].length_name)+1U);
+    }
+    const char *name = ARRGEN_BASENAME(h_path);
+    char *ret = createCName(name, strlen(name), "");
+    return sprintfAppend(ret, "_%016" PRIX64 "_INCLUDED", xxh64Digest(&state));
+}
+
+char* pathForOutput(const OutputFileParams* params, const char* path) {
+    if (!params->reproducible)
+        return duplicateString(path);
+    // same as gcc's -ffile-prefix-map, the last one given that matches wins
+    for (size_t i=params->num_path_prefix_maps; i>0U; i--) {
+        const char *map = params->path_prefix_maps[i-1U];
+        const size_t old_length = (size_t)(strchr(map, '=')-map);
+        if (strncmp(path, map, old_length)==0)
+            return sprintfAppend(NULL, "%s%s", &map[old_length+1U], &path[old_length]);
+    }
+    // relative paths are relative to the parameter file, so they're the same everywhere. absolute ones aren't
+#if defined(_WIN32) || defined(_WIN64)
+    if (path[0]=='/' || path[0]=='\\' || (path[0]!='\0' && path[1]==':'))
+#else
+    if (path[0]=='/')
+#endif
+        return duplicateString(ARRGEN_BASENAME(path));
+    return duplicateString(path);
+}
+
+static bool writeC(const OutputFileParams* params, OutputArrayInfo infos[]) {
+    DLOG("entering function");
+    if (params->external_data!=NULL)
+        return writeExternal(params, infos);
+    if (params->num_shards==1U) {
+        // stdout isn't a file anything could depend on
+        if (!isStdoutPath(params->c_path))
+            recordGeneratedFile(params->c_path);
+        return writeCFile(params, params->c_path, NULL, 0U, infos);
+    }
+    bool ret = true;
+    size_t *shard_of = malloc(sizeof(size_t)*params->num_inputs);
+    if (UNLIKELY(shard_of==NULL))
+        myFatalErrno("failed to allocate %zu bytes", sizeof(size_t)*params->num_inputs);
+    char *stem = pathWithoutExtension(params->c_path);
+    if (params->num_shards==0U) {
+        for (size_t i=0U; i<params->num_inputs; i++)
+            shard_of[i] = i;
+        for (size_t i=0U; (ret || params->check_only) && i<params->num_inputs; i++) {
+            char *shard_path = sprintfAppend(NULL, "%s.%s.c", stem, params->inputs[i].array_name);
+            recordGeneratedFile(shard_path);
+            ret = writeCFile(params, shard_path, shard_of, i, infos) && ret;
+            free(shard_path);
+        }
+    } else {
+        assignShards(params, shard_of);
+        for (size_t shard=0U; (ret || params->check_only) && shard<params->num_shards; shard++) {
+            char *shard_path = sprintfAppend(NULL, "%s.%zu.c", stem, shard);
+            recordGeneratedFile(shard_path);
+            ret = writeCFile(params, shard_path, shard_of, shard, infos) && ret;
+            free(shard_path);
         }
-        if (UNLIKELY(fclose(out)!=0))
-            myErrorErrno("%s: could not close", h_path);
-        ret = true;
-        free((void*)include_guard); // totally unnecessary but why not
     }
-    free((void*)h_path);
+    free(stem);
+    free(shard_of);
     DLOG("returning %hhu", ret);
     return (ret);
 }
 
-static bool writeC(const OutputFileParams* params, size_t lengths[]) {
-    DLOG("entering function");
-    FILE *out = fopen(params->c_path, "wb"); // CLRF is icky
-    bool ret;
-    if (UNLIKELY(out==NULL)) {
-        myErrorErrno("%s: could not open", params->c_path);
+// shards and split_size don't matter here, so the same settings can be used with and without external_data
+static bool writeExternal(const OutputFileParams* params, OutputArrayInfo infos[]) {
+    DLOG("entering function: %s", params->external_data);
+    recordGeneratedFile(params->external_data);
+    OutputFile output;
+    FILE *out = openOutputFile(&output, params->external_data, params->check_only);
+    if (UNLIKELY(out==NULL))
+        return false;
+    ExternalEntry *entries = malloc(sizeof(ExternalEntry)*(params->num_inputs+1U));
+    if (UNLIKELY(entries==NULL))
+        myFatalErrno("failed to allocate %zu bytes", sizeof(ExternalEntry)*(params->num_inputs+1U));
+    startExternalPack(out, params->num_inputs);
+    bool ret = true;
+    for (size_t i=0U; ret && i<params->num_inputs; i++) {
+        entries[i].offset = alignExternalPack(out, params->inputs[i].alignment);
+        ret = writeInput(out, params, i, &infos[i]);
+        entries[i].length = infos[i].length;
+    }
+    if (ret)
+        finishExternalPack(out, entries, params->num_inputs);
+    free(entries);
+    ret = closeOutputFile(&output, ret);
+    // nothing in the loader depends on the contents of the inputs, so it usually stays the same and doesn't need to be recompiled
+    if (ret || params->check_only) {
+        if (!isStdoutPath(params->c_path))
+            recordGeneratedFile(params->c_path);
+        OutputFile loader_output;
+        FILE *loader_out = openOutputFile(&loader_output, params->c_path, params->check_only);
+        if (UNLIKELY(loader_out==NULL))
+            return false;
+        fprintf(loader_out,
+            "#include \"%s\"\n",
+            params->h_name);
+        writeExternalLoader(loader_out, params);
+        ret = closeOutputFile(&loader_output, true) && ret;
+    }
+    DLOG("returning %hhu", ret);
+    return ret;
+}
+
+static bool writeCFile(const OutputFileParams* params, const char* path, const size_t shard_of[], size_t shard, OutputArrayInfo infos[]) {
+    DLOG("entering function: %s", path);
+    const double trace_start = traceNow();
+    OutputFile output;
+    FILE *out = openOutputFile(&output, path, params->check_only);
+    bool ret = true;
+    if (UNLIKELY(out==NULL))
         ret = false;
-    } else {
+    else {
+        // a file with just one input only needs that input's header
+        char *h_name = (params->num_shards==0U ? headerNameForInput(params, &params->inputs[shard]) : duplicateString(params->h_name));
         fprintf(out,
             "#include \"%s\"\n",
-            params->h_name);
+            h_name);
+        free(h_name);
         for (size_t i=0; i<params->num_inputs; i++) {
-            const InputFileParams *input = &params->inputs[i];
-            fprintf(out,
-                "%sunsigned char %s[%s] = {",
-                (input->make_const ? "const " : ""),
-                input->array_name,
-                input->length_name);
-            ssize_t length = writeFileContents(out, input);
-            ret = LIKELY(length>=0);
+            if (shard_of!=NULL && shard_of[i]!=shard)
+                continue;
+            ret = LIKELY(writeInput(out, params, i, &infos[i]));
             if (!ret)
                 break;
-            lengths[i] = (size_t)length;
-            fprintf(out, "};\n");
-        }
-        if (UNLIKELY(ferror(out))) {
-            // TODO
+            if (params->extern_length) {
+                fprintf(out,
+                    "const size_t %s = %" PRIu64 "U;\n",
+                    params->inputs[i].length_name,
+                    (uint64_t)infos[i].length);
+                if (params->inputs[i].pad_to>1U)
+                    fprintf(out,
+                        "const size_t %s_PADDED_LENGTH = %" PRIu64 "U;\n",
+                        params->inputs[i].array_name,
+                        (uint64_t)paddedLength(&params->inputs[i], infos[i].length));
+                writeChecksums(out, params, &params->inputs[i], &infos[i], false);
+                if (infos[i].num_chunks!=0U)
+                    fprintf(out,
+                        "const size_t %s_NUM_CHUNKS = %" PRIu64 "U;\n",
+                        params->inputs[i].array_name,
+                        (uint64_t)infos[i].num_chunks);
+            }
         }
-        if (UNLIKELY(fclose(out)!=0))
-            myErrorErrno("%s: could not close", params->c_path);
+        ret = closeOutputFile(&output, ret);
     }
+    traceSpan("source", path, trace_start);
     DLOG("returning %hhu", ret);
     return (ret);
 }
 
-static ssize_t writeFileContents(FILE* out, const InputFileParams *input) {
+// greedy biggest-first balancing by input size, which is roughly what decides how long each shard takes to compile
+static void assignShards(const OutputFileParams* params, size_t shard_of[]) {
+    SizedInput *order = malloc(sizeof(SizedInput)*params->num_inputs);
+    size_t *shard_totals = calloc(params->num_shards, sizeof(size_t));
+    if (UNLIKELY((order==NULL && params->num_inputs>0U) || shard_totals==NULL))
+        myFatalErrno("failed to allocate memory for %" PRIu32 " shards", params->num_shards);
+    for (size_t i=0U; i<params->num_inputs; i++) {
+        order[i] = (SizedInput) {
+            .size = inputSize(&params->inputs[i]),
+            .index = i,
+        };
+    }
+    qsort(order, params->num_inputs, sizeof(SizedInput), compareSizedInputs);
+    for (size_t i=0U; i<params->num_inputs; i++) {
+        size_t lightest = 0U;
+        for (size_t shard=1U; shard<params->num_shards; shard++)
+            if (shard_totals[shard]<shard_totals[lightest])
+                lightest = shard;
+        shard_of[order[i].index] = lightest;
+        shard_totals[lightest] += order[i].size;
+    }
+    free(shard_totals);
+    free(order);
+}
+
+// biggest first. equal sizes keep the order they were given in, since qsort isn't stable and the output has to be deterministic
+static int compareSizedInputs(const void* a, const void* b) {
+    const SizedInput *input_a = a, *input_b = b;
+    if (input_a->size!=input_b->size)
+        return (input_a->size>input_b->size ? -1 : 1);
+    return (input_a->index<input_b->index ? -1 : (input_a->index>input_b->index));
+}
+
+// only used to balance shards, so an input that can't be sized ahead of time just counts as empty
+static size_t inputSize(const InputFileParams *input) {
+    if (input->from_archive)
+        return (size_t)input->archive_length;
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+    struct stat stats;
+    if (stat(input->path_to_open, &stats)==0 && S_ISREG(stats.st_mode))
+        return (size_t)stats.st_size;
+#else
+    FILE *in = fopen(input->path_to_open, "rb");
+    if (in!=NULL) {
+        long size = (fseek(in, 0, SEEK_END)==0 ? ftell(in) : -1L);
+        fclose(in);
+        if (size>=0L)
+            return (size_t)size;
+    }
+#endif
+    return 0U;
+}
+
+static void recordGeneratedFile(const char* path) {
+    generated_files_ = realloc(generated_files_, sizeof(char*)*(num_generated_files_+1U));
+    if (UNLIKELY(generated_files_==NULL))
+        myFatalErrno("failed to allocate %zu bytes", sizeof(char*)*(num_generated_files_+1U));
+    generated_files_[num_generated_files_++] = duplicateString(path);
+}
+
+static bool writeOutputList(const char* path, bool check_only) {
+    DLOG("entering function: %s", path);
+    OutputFile output;
+    FILE *out = openOutputFile(&output, path, check_only);
+    if (UNLIKELY(out==NULL))
+        return false;
+    for (size_t i=0U; i<num_generated_files_; i++)
+        fprintf(out, "%s\n", generated_files_[i]);
+    return closeOutputFile(&output, true);
+}
+
+static bool writeDepfile(const OutputFileParams* params) {
+    DLOG("entering function: %s", params->depfile);
+    OutputFile output;
+    FILE *out = openOutputFile(&output, params->depfile, params->check_only);
+    if (UNLIKELY(out==NULL))
+        return false;
+    for (size_t i=0U; i<num_generated_files_; i++) {
+        writeMakeEscaped(out, generated_files_[i]);
+        fputs((i+1U<num_generated_files_ ? " " : ":"), out);
+    }
+    if (params->params_file!=NULL) {
+        fputs(" \\\n  ", out);
+        writeMakeEscaped(out, params->params_file);
+    }
+    for (size_t i=0U; i<params->num_inputs; i++) {
+        fputs(" \\\n  ", out);
+        writeMakeEscaped(out, params->inputs[i].path_to_open);
+    }
+    // the extra headers are included relative to the header, but make wants them relative to the working directory
+    const char *h_path = pathRelativeToFile(params->c_path, params->h_name);
+    for (size_t i=0U; i<params->num_extra_headers; i++) {
+        char *header_path = pathRelativeToFile(h_path, params->extra_headers[i]);
+        fputs(" \\\n  ", out);
+        writeMakeEscaped(out, header_path);
+        free(header_path);
+    }
+    fputs("\n", out);
+    // empty rules for everything except the generated files, so make doesn't fail if one of them gets deleted, like -MP
+    if (params->params_file!=NULL) {
+        fputs("\n", out);
+        writeMakeEscaped(out, params->params_file);
+        fputs(":\n", out);
+    }
+    for (size_t i=0U; i<params->num_inputs; i++) {
+        fputs("\n", out);
+        writeMakeEscaped(out, params->inputs[i].path_to_open);
+        fputs(":\n", out);
+    }
+    for (size_t i=0U; i<params->num_extra_headers; i++) {
+        char *header_path = pathRelativeToFile(h_path, params->extra_headers[i]);
+        fputs("\n", out);
+        writeMakeEscaped(out, header_path);
+        fputs(":\n", out);
+        free(header_path);
+    }
+    free((void*)h_path);
+    return closeOutputFile(&output, true);
+}
+
+// same escaping gcc does for -MD
+static void writeMakeEscaped(FILE* out, const char* path) {
+    for (const char* c=path; *c!='\0'; c++) {
+        switch (*c) {
+        case ' ':
+        case '\t':
+        case '#':
+            fputc('\\', out);
+            break;
+        case '$':
+            fputc('$', out);
+            break;
+        }
+        fputc(*c, out);
+    }
+}
+
+static char* headerNameForInput(const OutputFileParams* params, const InputFileParams *input) {
+    if (!params->header_per_input)
+        return duplicateString(params->h_name);
+    char *stem = pathWithoutExtension(params->h_name);
+    char *ret = sprintfAppend(NULL, "%s.%s.h", stem, input->array_name);
+    free(stem);
+    return ret;
+}
+
+static void writeArrayStart(FILE* out, const OutputFileParams* params, const InputFileParams *input) {
+    writeArrayPlacement(out, input, input->array_name, true);
+    if (params->cpp_constexpr) {
+        // the size comes from the initializer, since the length is only written after it
+        fprintf(out,
+            "inline constexpr unsigned char %s[] = {",
+            input->array_name);
+        return;
+    }
+    // with extern_length the length isn't a constant expression, so leave it to the initializer
+    fprintf(out,
+        "%sunsigned char %s[%s%s] = {",
+        (input->make_const ? "const " : ""),
+        input->array_name,
+        (params->extern_length ? "" : (input->pad_to>1U ? input->array_name : input->length_name)),
+        (!params->extern_length && input->pad_to>1U ? "_PADDED_LENGTH" : ""));
+}
+
+void writeArrayPlacement(FILE* out, const InputFileParams *input, const char* symbol_name, bool definition) {
+    if (input->alignment!=0U)
+        fprintf(out,
+            "#if defined(__GNUC__)\n"
+            "__attribute__ ((aligned(%" PRIu32 ")))\n"
+            "#elif defined(_MSC_VER)\n"
+            "__declspec(align(%" PRIu32 "))\n"
+            "#endif\n",
+            input->alignment,
+            input->alignment);
+    if (!definition)
+        return;
+    // the section name is up to the user, so it's on them to make it right for the object format
+    if (input->section!=NULL)
+        fprintf(out,
+            "#if defined(__GNUC__)\n"
+            "__attribute__ ((section(\"%s\")))\n"
+            "#endif\n",
+            input->section);
+    else if (input->gc_sections)
+        // named like -fdata-sections does it, so linker scripts put it with the rest of the data. only ELF has sections named like this
+        fprintf(out,
+            "#if defined(__GNUC__) && defined(__ELF__)\n"
+            "__attribute__ ((section(\"%s.%s\")))\n"
+            "#endif\n",
+            (input->make_const ? ".rodata" : ".data"),
+            symbol_name);
+}
+
+size_t paddedLength(const InputFileParams *input, size_t length) {
+    if (input->pad_to<=1U)
+        return length;
+    return (length+input->pad_to-1U)/input->pad_to*input->pad_to;
+}
+
+void writeArrayPadding(FILE* out, const InputFileParams *input, size_t length) {
+    static const uint8_t zeros[4096];
+    size_t padding = paddedLength(input, length)-length;
+    ssize_t cur_line_pos = -1;
+    while (padding>0U) {
+        const size_t num_zeros = (padding<sizeof(zeros) ? padding : sizeof(zeros));
+        writeArrayContents(out, zeros, num_zeros, &cur_line_pos, input->line_length);
+        padding -= num_zeros;
+    }
+}
+
+static bool writeArrayFromMemory(FILE* out, const OutputFileParams* params, const InputFileParams *input, const uint8_t* mem, size_t length, OutputArrayInfo *info) {
+    uint8_t *transformed = NULL;
+    if (input->transform!=ARRGEN_TRANSFORM_NONE) {
+        // all at once rather than a piece at a time, so splitting and the cache work on the bytes actually embedded
+        transformed = malloc(length+ARRGEN_TRANSFORM_SLACK);
+        if (UNLIKELY(transformed==NULL))
+            myFatalErrno("failed to allocate %zu bytes", length+ARRGEN_TRANSFORM_SLACK);
+        const double transform_start = statsNow();
+        const double trace_start = traceNow();
+        TransformState transform;
+        startTransform(&transform, input->transform);
+        const size_t transformed_length = transformBytes(&transform, mem, length, transformed);
+        length = transformed_length+finishTransform(&transform, &transformed[transformed_length]);
+        statsAddTime(STATS_FORMAT, transform_start);
+        traceSpan("transform", input->path_original, trace_start);
+        mem = transformed;
+        DLOG("%s: %zu bytes after transform %hhu", input->path_to_open, length, input->transform);
+    }
+    info->length = length;
+    ChecksumState checksums;
+    startChecksums(&checksums, input->checksums);
+    bool ret = true;
+    if (params->external_data!=NULL) {
+        // out is the pack, which gets the bytes themselves. copying them there takes the place of formatting them, so it counts as that
+        const double copy_start = statsNow();
+        const double trace_start = traceNow();
+        info->num_chunks = 0U;
+        updateChecksums(&checksums, mem, length);
+        if (UNLIKELY(fwrite(mem, 1, length, out)!=length))
+            myFatalErrno("fwrite");
+        for (size_t i=length; i<paddedLength(input, length); i++)
+            putc(0, out);
+        statsAddTime(STATS_FORMAT, copy_start);
+        traceSpan("copy", input->path_original, trace_start);
+    } else if (input->split_size!=0U && length>input->split_size)
+        ret = writeArraySplit(out, params, input, mem, length, info, &checksums);
+    else {
+        info->num_chunks = 0U;
+        writeArrayStart(out, params, input);
+        writeArrayContentsFromMemory(out, params, input, mem, length, &checksums);
+        writeArrayPadding(out, input, length);
+        fprintf(out, "};\n");
+    }
+    finishChecksums(&checksums, info);
+    free(transformed);
+    return ret;
+}
+
+static void writeArrayContentsFromMemory(FILE* out, const OutputFileParams* params, const InputFileParams *input, const uint8_t* mem, size_t length, ChecksumState* checksums) {
+    // for a mapped input, this is also where it's actually read from the disk, as page faults
+    const double format_start = statsNow();
+    const double trace_start = traceNow();
+    if (params->cache_dir!=NULL) {
+        // a cache hit doesn't format anything, so there's nothing to do it alongside
+        updateChecksums(checksums, mem, length);
+        writeArrayContentsCached(out, params->cache_dir, mem, length, input->base, input->aligned, input->line_length, params->check_only);
+    } else if (checksums->which!=0U) {
+        // a buffer's worth at a time, so each piece is still in the CPU cache when it's formatted right after being checksummed,
+        // and a big input is only read from memory once
+        ssize_t cur_line_pos = -1;
+        size_t offset = 0U;
+        do {
+            const size_t piece_length = (length-offset < ARRGEN_BUFFER_SIZE ? length-offset : ARRGEN_BUFFER_SIZE);
+            updateChecksums(checksums, &mem[offset], piece_length);
+            writeArrayContents(out, &mem[offset], piece_length, &cur_line_pos, input->line_length);
+            offset += piece_length;
+        } while (offset<length);
+    } else {
+        ssize_t cur_line_pos = -1;
+        writeArrayContents(out, mem, length, &cur_line_pos, input->line_length);
+    }
+    statsAddTime(STATS_FORMAT, format_start);
+    traceSpan("format", input->path_original, trace_start);
+}
+
+static void startChecksums(ChecksumState* checksums, uint8_t which) {
+    checksums->which = which;
+    checksums->crc32c = 0U;
+    if (which & ARRGEN_CHECKSUM_XXH64)
+        xxh64Init(&checksums->xxh64, 0U);
+}
+
+static void updateChecksums(ChecksumState* checksums, const uint8_t* buf, size_t length) {
+    if (checksums->which & ARRGEN_CHECKSUM_CRC32C)
+        checksums->crc32c = crc32cUpdate(checksums->crc32c, buf, length);
+    if (checksums->which & ARRGEN_CHECKSUM_XXH64)
+        xxh64Update(&checksums->xxh64, buf, length);
+}
+
+static void finishChecksums(const ChecksumState* checksums, OutputArrayInfo *info) {
+    info->crc32c = checksums->crc32c;
+    info->xxh64 = (checksums->which & ARRGEN_CHECKSUM_XXH64 ? xxh64Digest(&checksums->xxh64) : 0U);
+}
+
+// each chunk goes in its own .c file next to the main one, so the compiler never has to hold the whole input at once and the chunks can be compiled in parallel.
+// the main .c file gets a table of pointers to the chunks, since there's no portable way to make separately compiled arrays contiguous
+static bool writeArraySplit(FILE* out, const OutputFileParams* params, const InputFileParams *input, const uint8_t* mem, size_t length, OutputArrayInfo *info, ChecksumState* checksums) {
+    DLOG("splitting %s (%zu bytes) into chunks of %" PRIu32 " bytes", input->path_to_open, length, input->split_size);
+    const char* const_text = (input->make_const ? "const " : "");
+    const size_t num_chunks = (length+input->split_size-1U)/input->split_size;
+    char *stem = pathWithoutExtension(params->c_path);
+    char *h_name = headerNameForInput(params, input);
+    bool ret = true;
+    for (size_t i=0U; ret && i<num_chunks; i++) {
+        char *chunk_path = sprintfAppend(NULL, "%s.%s.%zu.c", stem, input->array_name, i);
+        recordGeneratedFile(chunk_path);
+        OutputFile chunk_output;
+        FILE *chunk_out = openOutputFile(&chunk_output, chunk_path, params->check_only);
+        if (UNLIKELY(chunk_out==NULL))
+            ret = false;
+        else {
+            const size_t offset = i*input->split_size;
+            const size_t chunk_length = (length-offset < input->split_size ? length-offset : input->split_size);
+            fprintf(chunk_out,
+                "#include \"%s\"\n"
+                "%s",
+                h_name,
+                (input->attributes==NULL ? "" : input->attributes));
+            char *chunk_name = sprintfAppend(NULL, "%s_CHUNK_%zu", input->array_name, i);
+            writeArrayPlacement(chunk_out, input, chunk_name, true);
+            fprintf(chunk_out,
+                "%sunsigned char %s[%zu] = {",
+                const_text,
+                chunk_name,
+                chunk_length);
+            free(chunk_name);
+            writeArrayContentsFromMemory(chunk_out, params, input, &mem[offset], chunk_length, checksums);
+            fprintf(chunk_out, "};\n");
+            ret = closeOutputFile(&chunk_output, true);
+        }
+        free(chunk_path);
+    }
+    free(h_name);
+    free(stem);
+    if (ret) {
+        for (size_t i=0U; i<num_chunks; i++)
+            fprintf(out, "extern %sunsigned char %s_CHUNK_%zu[];\n", const_text, input->array_name, i);
+        fprintf(out, "%sunsigned char* const %s_CHUNKS[%s%s] = {\n",
+            const_text,
+            input->array_name,
+            (params->extern_length ? "" : input->array_name),
+            (params->extern_length ? "" : "_NUM_CHUNKS"));
+        for (size_t i=0U; i<num_chunks; i++)
+            fprintf(out, "    %s_CHUNK_%zu,\n", input->array_name, i);
+        fprintf(out, "};\n");
+    }
+    info->num_chunks = num_chunks;
+    return ret;
+}
+
+static bool writeInput(FILE* out, const OutputFileParams* params, size_t index, OutputArrayInfo *info) {
+#ifdef ARRGEN_WATCH_SUPPORTED
+    if (index<num_remembered_) {
+        RememberedArray *remembered = &remembered_[index];
+        bool ret = true;
+        if (remembered->text==NULL) {
+            FILE *mem = open_memstream(&remembered->text, &remembered->text_length);
+            if (UNLIKELY(mem==NULL))
+                myFatalErrno("open_memstream");
+            ret = writeFileContents(mem, params, &params->inputs[index], info);
+            if (UNLIKELY(fclose(mem)!=0))
+                myFatalErrno("%s: could not write to memory", params->inputs[index].path_to_open);
+            remembered->info = *info;
+        } else {
+            DLOG("%s: reusing the text from last time", params->inputs[index].path_to_open);
+        }
+        fwrite(remembered->text, 1, remembered->text_length, out);
+        *info = remembered->info;
+        // split inputs write their chunk files as they go, so they can't be skipped next time
+        if (!ret || info->num_chunks!=0U)
+            forgetArray(index);
+        return ret;
+    }
+#endif // ARRGEN_WATCH_SUPPORTED
+    const double trace_start = traceNow();
+    bool ret;
+    if (LIKELY(!stats_enabled_))
+        ret = writeFileContents(out, params, &params->inputs[index], info);
+    else {
+        statsStartInput(&params->inputs[index]);
+        const long start_offset = ftell(out);
+        ret = writeFileContents(out, params, &params->inputs[index], info);
+        statsFinishInput(info->length, info->num_chunks, (start_offset<0 ? -1 : ftell(out)-start_offset));
+    }
+    traceSpan("input", params->inputs[index].path_original, trace_start);
+    return ret;
+}
+
+static bool writeFileContents(FILE* out, const OutputFileParams* params, const InputFileParams *input, OutputArrayInfo *info) {
     DLOG("entering function");
     ssize_t length;
+    info->num_chunks = 0U;
     initializeLookup(input->base, input->aligned);
+    if (input->from_archive)
+        return writeArchiveMember(out, params, input, info);
     // following a no-early-return policy here because of the various unwinding necessary
 #if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+    double trace_start = traceNow();
     int fd = open(input->path_to_open, O_RDONLY);
     if (UNLIKELY(fd<0)) {
         myErrorErrno("%s: could not open", input->path_to_open);
         length = -1;
     } else {
         struct stat stats;
-        if (UNLIKELY(fstat(fd, &stats)!=0)) {
+        const int fstat_res = fstat(fd, &stats);
+        traceSpan("open", input->path_original, trace_start);
+        if (UNLIKELY(fstat_res!=0)) {
             myErrorErrno("%s: could not fstat fd %d", input->path_to_open, fd);
             length = -1;
         } else {
             switch (stats.st_mode & S_IFMT) {
             case S_IFREG: {
                 length = stats.st_size;
+                trace_start = traceNow();
                 // TODO: consider if it should fall back to streaming on mmap failure
                 const uint8_t* mem = (const uint8_t*) mmap(NULL, (size_t)length, PROT_READ, MAP_SHARED, fd, 0);
                 if (UNLIKELY(close(fd)!=0))
@@ -196,10 +1208,16 @@ static ssize_t writeFileContents(FILE* out, const InputFileParams *input) {
                         if (UNLIKELY(madvise((void*)mem, (size_t)length, MADV_SEQUENTIAL)))
                             myErrorErrno("%s: could not madvise for %zd bytes at %p", input->path_to_open, length, mem);
                     }
-                    ssize_t cur_line_pos = -1;
-                    writeArrayContents(out, mem, (size_t)length, &cur_line_pos, input->line_length);
+                    traceSpan("map", input->path_original, trace_start);
+                    statsSetSource("mmap", (uint64_t)length);
+                    mapped_input_ = mem;
+                    mapped_input_length_ = (size_t)length;
+                    bool written = writeArrayFromMemory(out, params, input, mem, (size_t)length, info);
+                    mapped_input_ = NULL;
                     if (UNLIKELY(munmap((void*)mem, (size_t)length))!=0)
                         myErrorErrno("%s: munmap", input->path_to_open);
+                    if (UNLIKELY(!written))
+                        length = -1;
                 }
                 }; break;
             case S_IFBLK:
@@ -214,7 +1232,9 @@ static ssize_t writeFileContents(FILE* out, const InputFileParams *input) {
                     if (UNLIKELY(close(fd)!=0))
                         myErrorErrno("%s: could not close fd %d", input->path_to_open, fd);
                 } else {
-                    length = writeArrayStreamed(out, in, input->path_to_open, input->line_length);
+                    input_file_ = in;
+                    length = writeArrayStreamed(out, in, params, input, info);
+                    input_file_ = NULL;
                     if (UNLIKELY(fclose(in)!=0))
                         myErrorErrno("%s: could not fclose", input->path_to_open);
                 }
@@ -229,6 +1249,7 @@ static ssize_t writeFileContents(FILE* out, const InputFileParams *input) {
     // TODO investigate whether OpenFileMappingA can be used instead of the double-handle, would it simplify? would it have the same effect/level of control?
     // TODO query file type with GetFileType, to determine if memory map is supported. also fall back on regular I/O if there's a failure (is there a HANDLE equivalent of fdopen? probably not a portable one)
     // TODO try this with not-locally-downloaded dropbox files or the like
+    double trace_start = traceNow();
     HANDLE handle = CreateFileA(
         input->path_to_open,
         GENERIC_READ, // I only want to read the file
@@ -238,7 +1259,9 @@ static ssize_t writeFileContents(FILE* out, const InputFileParams *input) {
         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, // don't open it unbuffered, don't change it to hidden, and a bunch of other weird misc stuff. But hint to Windows that I'll read the file sequentially, sorta like madvise. (Can't figure out if it matters for memory-mapped I/O.)
         NULL // parameters to give the newly created file, doesn't matter because I'm not creating a file
         );
+    traceSpan("open", input->path_original, trace_start);
     if (LIKELY(handle!=INVALID_HANDLE_VALUE)) {
+        trace_start = traceNow();
         // TODO decide whether to map with exclusive access or not. I think I don't care because writes/deletes should be prevented by the FILE_SHARE_READ.
         HANDLE mapping_handle = CreateFileMappingA(
             handle,
@@ -260,9 +1283,11 @@ static ssize_t writeFileContents(FILE* out, const InputFileParams *input) {
                 0, // start at the beginning of the file (don't get the difference between these two)
                 length  // map the entire file
             );
+            traceSpan("map", input->path_original, trace_start);
             if (LIKELY(mem!=NULL)) {
-                ssize_t cur_line_pos = -1;
-                writeArrayContents(out, mem, (size_t)length, &cur_line_pos, input->line_length);
+                statsSetSource("mmap", (uint64_t)length);
+                if (UNLIKELY(!writeArrayFromMemory(out, params, input, mem, (size_t)length, info)))
+                    length = -1;
             } else
                 myFatalWindowsError("%s: MapViewOfFile failed for file size %zu bytes", input->path_to_open, length);
             if (UNLIKELY(!UnmapViewOfFile(mem)))
@@ -276,37 +1301,174 @@ static ssize_t writeFileContents(FILE* out, const InputFileParams *input) {
     } else
         myFatalWindowsError("%s: CreateFileA", input->path_to_open);
 #else // ARRGEN_MMAP_TYPE_NONE
+    const double trace_start = traceNow();
     FILE* in = fopen(input->path_to_open, "rb");
+    traceSpan("open", input->path_original, trace_start);
     if (UNLIKELY(in==NULL)) {
         myErrorErrno("%s: could not fopen", input->path_to_open);
         length = -1;
     } else {
-        length = writeArrayStreamed(out, in, input->path_to_open, input->line_length);
+        input_file_ = in;
+        length = writeArrayStreamed(out, in, params, input, info);
+        input_file_ = NULL;
         if (UNLIKELY(fclose(in)!=0))
             myErrorErrno("%s: could not fclose", input->path_to_open);
     }
 #endif // ARRGEN_MMAP_SUPPORTED
     DLOG("returning %zd", length);
-    return (length);
+    return (length>=0);
 }
 
-static ssize_t writeArrayStreamed(FILE* out, FILE* in, const char* in_path, size_t line_limit) {
-    DLOG("entering function: %p, %p, %s", out, in, in_path);
-    size_t num_read = ARRGEN_BUFFER_SIZE, total_length;
-    static uint8_t buf[ARRGEN_BUFFER_SIZE];
+// the total length isn't known until the end, so inputs read this way are never split
+static ssize_t writeArrayStreamed(FILE* out, FILE* in, const OutputFileParams* params, const InputFileParams *input, OutputArrayInfo *info) {
+    DLOG("entering function: %p, %p, %s", out, in, input->path_to_open);
+    size_t num_read = ARRGEN_BUFFER_SIZE, total_length, embedded_length = 0U;
+    static ARRGEN_THREAD_LOCAL uint8_t buf[ARRGEN_BUFFER_SIZE];
+    static ARRGEN_THREAD_LOCAL uint8_t transformed[ARRGEN_BUFFER_SIZE+ARRGEN_TRANSFORM_SLACK];
+    TransformState transform;
+    startTransform(&transform, input->transform);
     int error = 0;
     ssize_t cur_line_pos = -1;
+    ChecksumState checksums;
+    startChecksums(&checksums, input->checksums);
+    // with external_data, out is the pack, which gets the bytes themselves
+    const bool raw = (params->external_data!=NULL);
+    if (!raw)
+        writeArrayStart(out, params, input);
+    // reading and formatting alternate a buffer at a time, so they're one span rather than thousands of tiny ones
+    const double trace_start = traceNow();
     for (total_length=0U; num_read==ARRGEN_BUFFER_SIZE; total_length+=num_read) {
         num_read = fread(buf, 1, ARRGEN_BUFFER_SIZE, in);
-        if (UNLIKELY(num_read != ARRGEN_BUFFER_SIZE)) {
+        if (UNLIKELY(num_read != ARRGEN_BUFFER_SIZE) && !LIKELY(feof(in))) {
             error = errno;
-            if (!LIKELY(feof(in)))
-                myError("%s: read: %s", in_path, strerror(error));
+            myError("%s: read: %s", input->path_to_open, strerror(error));
+        }
+        DLOG("%s: num_read = %zu\ttotal_length=%zu", input->path_to_open, num_read, total_length);
+        const double format_start = statsNow();
+        const uint8_t *piece = buf;
+        size_t piece_length = num_read;
+        if (input->transform!=ARRGEN_TRANSFORM_NONE) {
+            piece = transformed;
+            piece_length = transformBytes(&transform, buf, num_read, transformed);
+            if (num_read!=ARRGEN_BUFFER_SIZE)
+                piece_length += finishTransform(&transform, &transformed[piece_length]);
         }
-        DLOG("%s: num_read = %zu\ttotal_length=%zu", in_path, num_read, total_length);
-        writeArrayContents(out, buf, num_read, &cur_line_pos, line_limit);
+        updateChecksums(&checksums, piece, piece_length);
+        if (raw) {
+            if (UNLIKELY(fwrite(piece, 1, piece_length, out)!=piece_length))
+                myFatalErrno("fwrite");
+        } else
+            writeArrayContents(out, piece, piece_length, &cur_line_pos, input->line_length);
+        embedded_length += piece_length;
+        statsAddTime(STATS_FORMAT, format_start);
+    }
+    traceSpan("stream", input->path_original, trace_start);
+    statsSetSource("stream", total_length);
+    // only known now, so the array has already been written whole
+    if (UNLIKELY(input->split_size!=0U && !raw && embedded_length>input->split_size))
+        myError("%s: can only split inputs that can be memory-mapped, wrote %zu bytes as a single array", input->path_to_open, embedded_length);
+    if (raw) {
+        for (size_t i=embedded_length; i<paddedLength(input, embedded_length); i++)
+            putc(0, out);
+    } else {
+        writeArrayPadding(out, input, embedded_length);
+        fprintf(out, "};\n");
     }
-    return (error==0 ? (ssize_t)total_length : -1);
+    finishChecksums(&checksums, info);
+    info->length = embedded_length;
+    return (error==0 ? (ssize_t)embedded_length : -1);
 }
 
+static bool writeArchiveMember(FILE* out, const OutputFileParams* params, const InputFileParams *input, OutputArrayInfo *info) {
+    DLOG("%s: %" PRIu64 " bytes at offset %" PRIu64 " in %s", input->path_original, input->archive_length, input->archive_offset, input->path_to_open);
+    bool ret;
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+    if (mapped_archive_.path==NULL || strcmp(mapped_archive_.path, input->path_to_open)) {
+        unmapArchive();
+        double trace_start = traceNow();
+        int fd = open(input->path_to_open, O_RDONLY);
+        if (UNLIKELY(fd<0)) {
+            myErrorErrno("%s: could not open", input->path_to_open);
+            return false;
+        }
+        struct stat stats;
+        const int fstat_res = fstat(fd, &stats);
+        traceSpan("open", input->path_to_open, trace_start);
+        if (UNLIKELY(fstat_res!=0)) {
+            myErrorErrno("%s: could not fstat fd %d", input->path_to_open, fd);
+            close(fd);
+            return false;
+        }
+        trace_start = traceNow();
+        const uint8_t *mem = NULL;
+        if (stats.st_size>0) {
+            mem = (const uint8_t*) mmap(NULL, (size_t)stats.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (UNLIKELY(mem==MAP_FAILED)) {
+                myErrorErrno("%s: mmap", input->path_to_open);
+                close(fd);
+                return false;
+            }
+            // the members are almost always written in the order they're in the archive
+            if ((size_t)stats.st_size > arrgen_pagesize_ && UNLIKELY(madvise((void*)mem, (size_t)stats.st_size, MADV_SEQUENTIAL)))
+                myErrorErrno("%s: could not madvise for %zu bytes at %p", input->path_to_open, (size_t)stats.st_size, mem);
+        }
+        if (UNLIKELY(close(fd)!=0))
+            myErrorErrno("%s: could not close fd %d", input->path_to_open, fd);
+        traceSpan("map", input->path_to_open, trace_start);
+        mapped_archive_ = (MappedArchive) {
+            .path = duplicateString(input->path_to_open),
+            .mem = mem,
+            .length = (size_t)stats.st_size,
+        };
+    }
+    if (UNLIKELY(input->archive_offset>mapped_archive_.length || input->archive_length>mapped_archive_.length-input->archive_offset)) {
+        myError("%s: %s goes past the end of the archive, did it change?", input->path_to_open, input->path_original);
+        return false;
+    }
+    statsSetSource("archive", input->archive_length);
+    ret = writeArrayFromMemory(out, params, input, &mapped_archive_.mem[input->archive_offset], (size_t)input->archive_length, info);
+#else
+    // without mmap, read just the member into memory so it can still be split like any other memory-mapped input
+    uint8_t *mem = malloc((size_t)input->archive_length+1U);
+    if (UNLIKELY(mem==NULL))
+        myFatalErrno("failed to allocate %zu bytes", (size_t)input->archive_length+1U);
+    const double trace_start = traceNow();
+    FILE *in = fopen(input->path_to_open, "rb");
+    if (UNLIKELY(in==NULL)) {
+        myErrorErrno("%s: could not fopen", input->path_to_open);
+        ret = false;
+    } else {
+#   if defined(_WIN32) || defined(_WIN64)
+        ret = (_fseeki64(in, (__int64)input->archive_offset, SEEK_SET)==0);
+#   else
+        ret = (fseek(in, (long)input->archive_offset, SEEK_SET)==0);
+#   endif
+        if (UNLIKELY(!ret || fread(mem, 1, (size_t)input->archive_length, in)!=(size_t)input->archive_length)) {
+            if (ferror(in))
+                myErrorErrno("%s: read", input->path_to_open);
+            else
+                myError("%s: %s goes past the end of the archive, did it change?", input->path_to_open, input->path_original);
+            ret = false;
+        }
+        if (UNLIKELY(fclose(in)!=0))
+            myErrorErrno("%s: could not fclose", input->path_to_open);
+        traceSpan("read", input->path_original, trace_start);
+        statsSetSource("archive", input->archive_length);
+        if (ret)
+            ret = writeArrayFromMemory(out, params, input, mem, (size_t)input->archive_length, info);
+    }
+    free(mem);
+#endif // ARRGEN_MMAP_SUPPORTED
+    return ret;
+}
 
+static void unmapArchive(void) {
+    if (mapped_archive_.path==NULL)
+        return;
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+    if (mapped_archive_.mem!=NULL && UNLIKELY(munmap((void*)mapped_archive_.mem, mapped_archive_.length)!=0))
+        myErrorErrno("%s: munmap", mapped_archive_.path);
+#endif
+    free(mapped_archive_.path);
+    mapped_archive_.path = NULL;
+}
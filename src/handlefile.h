@@ -19,31 +19,68 @@
 #ifndef HANDLEFILE_H_INCLUDED
 #define HANDLEFILE_H_INCLUDED
 #include "arrgen.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
 
 // why are these defined here and not in parameters.h?
 
+// which checksums of an input to put in the header, as flags
+#define ARRGEN_CHECKSUM_CRC32C 1U
+#define ARRGEN_CHECKSUM_XXH64 2U
+
 typedef struct {
     const char* path_original; // path to file, as originally specified by user
     const char* path_to_open; // path to file, relative to current working directory (may be different because above can be relative to parameter file, if specified in parameter file)
+    uint64_t archive_offset; // if from_archive, where the contents start in the tar archive at path_to_open
+    uint64_t archive_length;
     const char* length_name;
     const char* array_name;
     char* attributes;
     uint32_t line_length;
+    uint32_t split_size; // inputs bigger than this are split into chunk arrays in separate .c files. 0 means never split
     uint8_t base;
+    uint8_t checksums; // ARRGEN_CHECKSUM_* flags
+    uint8_t transform; // ARRGEN_TRANSFORM_* from transform.h, done to the bytes before anything else, so the length and checksums are of what's embedded
+    const char* section; // the section to put the array in, or NULL to leave it up to the compiler (or gc_sections)
+    uint32_t alignment; // of the array's address in bytes, 0 to leave it up to the compiler
+    uint32_t pad_to; // the array is padded with zeros to a multiple of this many bytes. 0 or 1 means no padding
+    bool gc_sections; // without a section, give the array a section of its own, so the linker's --gc-sections can drop it if it's unused
     bool aligned;
     bool make_const;
+    bool from_archive; // path_to_open is a tar archive, and the contents are the archive_length bytes at archive_offset in it
 } InputFileParams;
 
 typedef struct {
     const char* c_path; // file path of the c file to generate, relative to current working directory
     const char* h_name; // file path of the header, relative to the directory containing the c file
-    char* header_top_text; // extra lines to insert in the top of the generated header file, verbatim (ie relative to the header file)
+    char* header_top_text; // extra lines to insert in the top of the generated header file, verbatim (ie relative to the header file). put together from header_includes by finishParams
     const char* params_file; // the file the settings were loaded from, if any
+    const char* output_list; // if not null, write the paths of all generated files here, one per line
+    const char* depfile; // if not null, write a makefile fragment here listing what the generated files depend on, like gcc -MMD
+    const char* cache_dir; // if not null, keep the formatted text of each input here, to reuse when the same input is formatted the same way again
+    const char* external_data; // if not null, put the contents of the inputs in this pack file instead, with a loader for it in the .c file. see externaldata.h
+    char* external_data_name; // the prefix of the loader functions, made from the pack's name by finishParams
+    char** header_includes; // the headers from extra_header and extra_system_header in the order given, with their quotes or angle brackets
+    size_t num_header_includes;
+    char** extra_headers; // the headers from extra_header, relative to the header file, for the depfile
+    size_t num_extra_headers;
+    char** path_prefix_maps; // OLD=NEW, applied to input paths written in the output in reproducible mode
+    size_t num_path_prefix_maps;
+    uint32_t num_shards; // number of .c files to spread the arrays over, balanced by input size. 0 means one per input
     bool create_header;
     bool constexpr_length; // make the lengths constexpr instead of defines
+    const char* module_name; // if not null, write a C++20 module interface unit exporting the arrays instead of a header. implies cpp_constexpr
+    bool cpp_constexpr; // write only a C++ header, with the arrays themselves defined in it as inline constexpr, and no .c file
+    bool extern_length; // make the lengths extern const variables defined in the .c files, so the header doesn't change when an input's size does
+    bool header_per_input; // give each input its own header, with the main header just including all of them
+    bool reproducible; // keep anything that depends on where the build is happening out of the output
+    bool check_only; // don't write anything, just fail if any of the outputs are out of date
+    Arena arena; // where all the strings and arrays above are allocated, so they're freed all at once with the rest of the parameters
+    size_t first_input_of_entry; // where the inputs from the last @ line start. the parameters after it apply to all of them
     size_t num_inputs;
     InputFileParams inputs[];
 } OutputFileParams;
@@ -52,6 +89,66 @@ bool handleFile(const OutputFileParams* params)
     ATTR_ACCESS(read_only, 1)
     ATTR_NONNULL;
 
+/**
+ * @brief cleans up after a handleFile on this thread that a fatal error in libarrgen cut short: closes the inputs and outputs
+ * it had open, removing the outputs' temporary files, and frees what it allocated. does nothing if there's nothing left
+*/
+void abandonHandleFile(void);
+
+#ifdef ARRGEN_WATCH_SUPPORTED
+/**
+ * @brief makes handleFile keep the text it writes for each input in memory, and write that again next time instead of reading
+ * and formatting the input again, until forgetArray is called for it. forgets everything remembered before. for watch mode,
+ * so it's only meant for one thread handling one settings file
+ * @param num_inputs the number of inputs in the settings that will be given to handleFile
+*/
+void rememberArrays(size_t num_inputs);
+
+/**
+ * @brief makes handleFile read and format the input at index again next time, because it changed
+*/
+void forgetArray(size_t index);
+#endif // ARRGEN_WATCH_SUPPORTED
+
+/**
+ * @brief writes the attributes for where an array goes in memory (alignment, and for definitions, the section), each
+ * wrapped in a check for a compiler that supports it. writes nothing if none of them are set
+ * @param symbol_name the array being declared or defined, used for the name of its own section with gc_sections
+ * @param definition false for an extern declaration, where the section doesn't matter
+*/
+void writeArrayPlacement(FILE* out, const InputFileParams *input, const char* symbol_name, bool definition)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(read_only, 3)
+    ATTR_NONNULL;
+
+/**
+ * @brief the number of bytes an array with length bytes of contents has, after padding to a multiple of pad_to
+*/
+size_t paddedLength(const InputFileParams *input, size_t length)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_PURE
+    ATTR_NONNULL;
+
+/**
+ * @brief writes the zeros after an array's contents that pad it out to paddedLength, on a line of their own.
+ * initializeLookup must have been called for the input's base and aligned
+*/
+void writeArrayPadding(FILE* out, const InputFileParams *input, size_t length)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_NONNULL;
+
+/**
+ * @brief gets the version of an input path to write in the output. in reproducible mode that means going through the
+ * path prefix maps, and cutting absolute paths that don't match any of them down to their base name
+*/
+ATTR_NODISCARD
+char* pathForOutput(const OutputFileParams* params, const char* path)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_MALLOC(free)
+    ATTR_NONNULL
+    ATTR_RETURNS_NONNULL;
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
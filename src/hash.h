@@ -0,0 +1,73 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HASH_H_INCLUDED
+#define HASH_H_INCLUDED
+#include "arrgen.h"
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// state for computing XXH64 (https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md) a piece at a time
+typedef struct {
+    uint64_t acc[4];
+    uint64_t total_length;
+    uint8_t buf[32]; // input that didn't fill a whole stripe yet
+    uint32_t buf_length;
+    uint64_t seed;
+} Xxh64State;
+
+void xxh64Init(Xxh64State* state, uint64_t seed)
+    ATTR_ACCESS(write_only, 1)
+    ATTR_NONNULL;
+
+/**
+ * @brief adds bytes to the hash
+ * @param state state from xxh64Init
+ * @param buf the bytes to add
+ * @param length number of bytes in buf
+*/
+void xxh64Update(Xxh64State* state, const uint8_t* buf, size_t length)
+    ATTR_ACCESS(read_write, 1)
+    ATTR_ACCESS(read_only, 2, 3)
+    ATTR_HOT
+    ATTR_NONNULL_N(1);
+
+/**
+ * @brief gets the hash of everything added so far. the state can still be updated afterwards
+*/
+uint64_t xxh64Digest(const Xxh64State* state)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_PURE
+    ATTR_NONNULL;
+
+/**
+ * @brief computes CRC-32C (the Castagnoli polynomial, the same as iSCSI and ext4 use), with the CPU's crc32 instructions if it has them
+ * @param crc 0 to start, or what it returned for the input so far to continue
+ * @param buf the bytes to add
+ * @param length number of bytes in buf
+*/
+uint32_t crc32cUpdate(uint32_t crc, const uint8_t* buf, size_t length)
+    ATTR_ACCESS(read_only, 2, 3)
+    ATTR_PURE
+    ATTR_HOT;
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // HASH_H_INCLUDED
@@ -0,0 +1,318 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arrgen.h"
+#include "inputglob.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+#   define ARRGEN_GLOB_SUPPORTED
+#   include <dirent.h>
+#   include <fnmatch.h>
+#   include <sys/stat.h>
+#endif
+#include "errors.h"
+#include "c_string_stuff.h"
+#include "workers.h"
+
+bool isInputPattern(const char* path) {
+    const size_t length = strlen(path);
+    return strpbrk(path, "*?[")!=NULL || (length>0U && path[length-1U]=='/');
+}
+
+#ifdef ARRGEN_GLOB_SUPPORTED
+// a directory to look in, and which component of the pattern its entries have to match
+typedef struct {
+    char *dir; // in the same form as the pattern, ending in / unless it's empty
+    size_t component;
+} GlobState;
+
+// what reading one directory found. filled in on a worker thread, so errors are saved to report afterwards instead of
+// being reported right away (errors.c only captures them on the thread that called into libarrgen)
+typedef struct {
+    GlobState *states;
+    size_t num_states;
+    char **matches;
+    size_t num_matches;
+    int error; // errno, if reading the directory failed
+    bool out_of_memory;
+} GlobResult;
+
+typedef struct {
+    char **components;
+    size_t num_components;
+    const char *open_prefix; // the directory of the settings file, which relative paths in the pattern are relative to
+    const GlobState *states;
+    GlobResult *results;
+} GlobLevel;
+
+static char** splitPattern(const char* pattern, size_t* num_components, size_t* first_wild)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_ACCESS(write_only, 2)
+    ATTR_ACCESS(write_only, 3)
+    ATTR_NONNULL;
+
+static bool readDirectoryTask(size_t index, void* level_ptr)
+    ATTR_NONNULL;
+
+static void matchEntry(const GlobLevel* level, const char* dir, size_t component, const char* name, bool is_dir, bool is_real_dir, GlobResult* result)
+    ATTR_NONNULL;
+
+static bool growArray(void** array, size_t num, size_t element_size)
+    ATTR_NONNULL;
+
+static int compareStrings(const void* a, const void* b)
+    ATTR_PURE
+    ATTR_NONNULL;
+
+char** expandInputPattern(const char* pattern, const char* params_file, size_t* num_matches) {
+    size_t num_components, first_wild;
+    GlobLevel level = {
+        .components = splitPattern(pattern, &num_components, &first_wild),
+    };
+    level.num_components = num_components;
+    const char *last_slash = strrchr(params_file, '/');
+    char *open_prefix = duplicateStringLen(params_file, (last_slash==NULL ? 0U : (size_t)(last_slash-params_file)+1U));
+    level.open_prefix = open_prefix;
+
+    // the components before the first one with a wildcard are just the directory to start in
+    char *start_dir = NULL;
+    for (size_t i=0U; i<first_wild; i++)
+        start_dir = sprintfAppend(start_dir, "%s/", level.components[i]);
+    GlobState *states = malloc(sizeof(GlobState));
+    if (UNLIKELY(states==NULL))
+        myFatalErrno("failed to allocate %zu bytes", sizeof(GlobState));
+    states[0] = (GlobState) {
+        .dir = (start_dir==NULL ? duplicateString("") : start_dir),
+        .component = first_wild,
+    };
+    size_t num_states = 1U;
+    char **matches = NULL;
+    *num_matches = 0U;
+
+    // a level at a time, each one's directories all read at once
+    while (num_states>0U) {
+        GlobResult *results = calloc(num_states, sizeof(GlobResult));
+        if (UNLIKELY(results==NULL))
+            myFatalErrno("failed to allocate %zu bytes", sizeof(GlobResult)*num_states);
+        level.states = states;
+        level.results = results;
+        runParallel(num_states, defaultNumThreads(), NULL, readDirectoryTask, &level);
+        GlobState *next_states = NULL;
+        size_t num_next_states = 0U;
+        for (size_t i=0U; i<num_states; i++) {
+            GlobResult *result = &results[i];
+            if (UNLIKELY(result->error!=0)) {
+                errno = result->error;
+                myFatalErrno("%s: could not read directory %s", pattern, (states[i].dir[0]=='\0' ? "." : states[i].dir));
+            }
+            if (UNLIKELY(result->out_of_memory))
+                myFatal("%s: ran out of memory", pattern);
+            for (size_t j=0U; j<result->num_matches; j++) {
+                if (UNLIKELY(!growArray((void**)&matches, *num_matches, sizeof(char*))))
+                    myFatalErrno("%s: failed to allocate memory for %zu matches", pattern, *num_matches+1U);
+                matches[(*num_matches)++] = result->matches[j];
+            }
+            for (size_t j=0U; j<result->num_states; j++) {
+                if (UNLIKELY(!growArray((void**)&next_states, num_next_states, sizeof(GlobState))))
+                    myFatalErrno("%s: failed to allocate memory for %zu directories", pattern, num_next_states+1U);
+                next_states[num_next_states++] = result->states[j];
+            }
+            free(result->matches);
+            free(result->states);
+            free(states[i].dir);
+        }
+        free(results);
+        free(states);
+        states = next_states;
+        num_states = num_next_states;
+    }
+
+    // the order directories are read in isn't, so sorting is what makes the output the same every time.
+    // a pattern like a/**/**/b can find the same file more than once
+    if (*num_matches>0U)
+        qsort(matches, *num_matches, sizeof(char*), compareStrings);
+    size_t num_unique = 0U;
+    for (size_t i=0U; i<*num_matches; i++) {
+        if (num_unique>0U && !strcmp(matches[num_unique-1U], matches[i]))
+            free(matches[i]);
+        else
+            matches[num_unique++] = matches[i];
+    }
+    *num_matches = num_unique;
+    DLOG("%s: %zu matches", pattern, num_unique);
+
+    free(open_prefix);
+    free(level.components[0]);
+    free(level.components);
+    return matches;
+}
+
+// the components all point into one copy of pattern, the first one being the start of it
+static char** splitPattern(const char* pattern, size_t* num_components, size_t* first_wild) {
+    const size_t length = strlen(pattern);
+    // a trailing / means every file under the directory, the same as a trailing /**/*. a trailing ** means the same too
+    char *copy = sprintfAppend(NULL, "%s%s", pattern,
+        (pattern[length-1U]=='/' ? "**/*" : (length>=2U && !strcmp(&pattern[length-2U], "**") ? "/*" : "")));
+    size_t max_components = 1U;
+    for (const char *c = copy; *c!='\0'; c++)
+        max_components += (*c=='/');
+    char **components = malloc(sizeof(char*)*max_components);
+    if (UNLIKELY(components==NULL))
+        myFatalErrno("failed to allocate %zu bytes", sizeof(char*)*max_components);
+    *num_components = 0U;
+    *first_wild = SIZE_MAX;
+    char *start = copy;
+    for (;;) {
+        char *slash = strchr(start, '/');
+        if (slash!=NULL)
+            *slash = '\0';
+        // empty components from a//b don't mean anything, but a leading one does, it's an absolute path
+        if (start[0]!='\0' || start==copy) {
+            if (*first_wild==SIZE_MAX && strpbrk(start, "*?[")!=NULL)
+                *first_wild = *num_components;
+            components[(*num_components)++] = start;
+        }
+        if (slash==NULL)
+            break;
+        start = slash+1;
+    }
+    return components;
+}
+
+static bool readDirectoryTask(size_t index, void* level_ptr) {
+    const GlobLevel *level = (const GlobLevel*)level_ptr;
+    const GlobState *state = &level->states[index];
+    GlobResult *result = &level->results[index];
+    // absolute paths in the pattern aren't relative to the settings file
+    const char *prefix = (state->dir[0]=='/' ? "" : level->open_prefix);
+    size_t path_size = strlen(prefix)+strlen(state->dir)+2U;
+    char *path = malloc(path_size);
+    if (UNLIKELY(path==NULL)) {
+        result->out_of_memory = true;
+        return false;
+    }
+    snprintf(path, path_size, "%s%s", prefix, state->dir);
+    DIR *dir = opendir(path[0]=='\0' ? "." : path);
+    if (UNLIKELY(dir==NULL)) {
+        result->error = errno;
+        free(path);
+        return false;
+    }
+    const size_t path_length = strlen(path);
+    struct dirent *entry;
+    errno = 0;
+    while ((entry = readdir(dir))!=NULL) {
+        const char *name = entry->d_name;
+        if (!strcmp(name, ".") || !strcmp(name, ".."))
+            continue;
+        bool is_dir = false, is_real_dir = false, type_known = false;
+#ifdef _DIRENT_HAVE_D_TYPE
+        if (entry->d_type==DT_DIR) {
+            is_dir = is_real_dir = type_known = true;
+        } else if (entry->d_type!=DT_LNK && entry->d_type!=DT_UNKNOWN)
+            type_known = true;
+#endif
+        if (!type_known) {
+            char *entry_path = malloc(path_length+strlen(name)+1U);
+            if (UNLIKELY(entry_path==NULL)) {
+                result->out_of_memory = true;
+                break;
+            }
+            memcpy(entry_path, path, path_length);
+            strcpy(&entry_path[path_length], name);
+            struct stat info;
+            if (lstat(entry_path, &info)==0) {
+                is_real_dir = S_ISDIR(info.st_mode);
+                // a symlink counts as whatever it points to, except for ** going into it
+                is_dir = (S_ISLNK(info.st_mode) ? stat(entry_path, &info)==0 && S_ISDIR(info.st_mode) : is_real_dir);
+            }
+            free(entry_path);
+        }
+        matchEntry(level, state->dir, state->component, name, is_dir, is_real_dir, result);
+        errno = 0;
+    }
+    if (UNLIKELY(errno!=0 && !result->out_of_memory))
+        result->error = errno;
+    closedir(dir);
+    free(path);
+    return result->error==0 && !result->out_of_memory;
+}
+
+static void matchEntry(const GlobLevel* level, const char* dir, size_t component, const char* name, bool is_dir, bool is_real_dir, GlobResult* result) {
+    const char *pattern = level->components[component];
+    if (!strcmp(pattern, "**")) {
+        // zero directories
+        matchEntry(level, dir, component+1U, name, is_dir, is_real_dir, result);
+        if (!is_real_dir || name[0]=='.')
+            return;
+    } else if (fnmatch(pattern, name, FNM_PERIOD)!=0)
+        return;
+    else if (component+1U==level->num_components) {
+        if (is_dir)
+            return;
+        size_t match_size = strlen(dir)+strlen(name)+1U;
+        char *match = malloc(match_size);
+        if (UNLIKELY(match==NULL || !growArray((void**)&result->matches, result->num_matches, sizeof(char*)))) {
+            free(match);
+            result->out_of_memory = true;
+            return;
+        }
+        snprintf(match, match_size, "%s%s", dir, name);
+        result->matches[result->num_matches++] = match;
+        return;
+    } else if (!is_dir)
+        return;
+    // a directory to look in on the next level. ** stays on the same component, since it can match more directories after this one
+    size_t dir_size = strlen(dir)+strlen(name)+2U;
+    char *next_dir = malloc(dir_size);
+    if (UNLIKELY(next_dir==NULL || !growArray((void**)&result->states, result->num_states, sizeof(GlobState)))) {
+        free(next_dir);
+        result->out_of_memory = true;
+        return;
+    }
+    snprintf(next_dir, dir_size, "%s%s/", dir, name);
+    result->states[result->num_states++] = (GlobState) {
+        .dir = next_dir,
+        .component = (!strcmp(pattern, "**") ? component : component+1U),
+    };
+}
+
+// doubles the capacity whenever num reaches a power of 2, so the capacity never needs to be stored
+static bool growArray(void** array, size_t num, size_t element_size) {
+    if ((num & (num-1U))!=0U)
+        return true;
+    void *grown = realloc(*array, element_size*(num==0U ? 1U : num*2U));
+    if (UNLIKELY(grown==NULL))
+        return false;
+    *array = grown;
+    return true;
+}
+
+static int compareStrings(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+#else
+
+char** expandInputPattern(const char* pattern, const char* params_file, size_t* num_matches ATTR_UNUSED) {
+    myFatal("%s: %s: patterns in input paths are not supported on this system", params_file, pattern);
+}
+
+#endif // ARRGEN_GLOB_SUPPORTED
@@ -0,0 +1,55 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INPUTGLOB_H_INCLUDED
+#define INPUTGLOB_H_INCLUDED
+#include "arrgen.h"
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * @brief whether an input path from a settings file is a pattern to expand rather than a single file: if it has *, ? or [ in it,
+ * or ends with / (which means every file under that directory). the settings file parser still takes one naming a file that
+ * exists as just that file
+*/
+bool isInputPattern(const char* path)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_PURE
+    ATTR_NONNULL;
+
+/**
+ * @brief finds the files matching pattern. each path component is matched like fnmatch, except that ** matches any number of
+ * directories (not following symlinks to them). names starting with . are only matched by components starting with . too.
+ * each level of directories is read in parallel. failure is fatal
+ * @param pattern relative to the directory params_file is in, like any other input path in a settings file
+ * @param num_matches set to the number of files found
+ * @return the paths found, in the same form as pattern (so relative to params_file, not the current directory), sorted by strcmp.
+ * the array and each path are allocated with malloc
+*/
+ATTR_NODISCARD
+char** expandInputPattern(const char* pattern, const char* params_file, size_t* num_matches)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_ACCESS(write_only, 3)
+    ATTR_NONNULL;
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // INPUTGLOB_H_INCLUDED
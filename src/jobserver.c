@@ -0,0 +1,193 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arrgen.h"
+#include "jobserver.h"
+#include "errors.h"
+#ifdef ARRGEN_JOBSERVER_SUPPORTED
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <limits.h>
+#   include <poll.h>
+#   include <stdio.h>
+#   include <stdlib.h>
+#   include <unistd.h>
+#   include "c_string_stuff.h"
+
+struct Jobserver {
+    int read_fd; // -1 if make passed a jobserver this process can't use
+    int write_fd;
+    bool read_nonblocking; // otherwise it's make's own pipe, which might be blocking, so reads have to poll first
+    bool close_read; // whether read_fd was opened here, rather than inherited from make
+};
+
+static const char* findJobserverAuth(const char* makeflags, size_t* length)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_ACCESS(write_only, 2)
+    ATTR_NONNULL;
+
+static bool parseJobserverFds(const char* auth, size_t length, int* read_fd, int* write_fd)
+    ATTR_ACCESS(read_only, 1, 2)
+    ATTR_ACCESS(write_only, 3)
+    ATTR_ACCESS(write_only, 4)
+    ATTR_NONNULL;
+
+Jobserver* connectJobserver(void) {
+    const char *makeflags = getenv("MAKEFLAGS");
+    if (makeflags==NULL)
+        return NULL;
+    size_t length = 0U; // only set if there's an auth, but gcc can't tell
+    const char *auth = findJobserverAuth(makeflags, &length);
+    if (auth==NULL)
+        return NULL;
+    Jobserver *jobserver = malloc(sizeof(Jobserver));
+    if (UNLIKELY(jobserver==NULL))
+        myFatalErrno("failed to allocate %zu bytes", sizeof(Jobserver));
+    *jobserver = (Jobserver) {
+        .read_fd = -1,
+        .write_fd = -1,
+    };
+    if (length>5U && memcmp(auth, "fifo:", 5U)==0) {
+        // make 4.4 and newer
+        char *path = duplicateStringLen(auth+5, length-5U);
+        int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (LIKELY(fd>=0)) {
+            jobserver->read_fd = jobserver->write_fd = fd;
+            jobserver->read_nonblocking = true;
+            jobserver->close_read = true;
+        } else {
+            DLOG("%s: could not open jobserver fifo (%s)", path, strerror(errno));
+        }
+        free(path);
+    } else {
+        int read_fd, write_fd;
+        if (LIKELY(parseJobserverFds(auth, length, &read_fd, &write_fd))
+            && fcntl(read_fd, F_GETFD)>=0
+            && fcntl(write_fd, F_GETFD)>=0) {
+            jobserver->read_fd = read_fd;
+            jobserver->write_fd = write_fd;
+#ifdef __linux__
+            // opening the pipe again gives a file description of its own, which can be made non-blocking without affecting
+            // make or anything else sharing the pipe
+            char proc_path[32];
+            snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", read_fd);
+            int fd = open(proc_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            if (fd>=0) {
+                jobserver->read_fd = fd;
+                jobserver->read_nonblocking = true;
+                jobserver->close_read = true;
+            }
+#endif // __linux__
+        } else {
+            DLOG("jobserver in MAKEFLAGS is not usable, probably not run as a recursive make");
+        }
+    }
+    DLOG("jobserver: read %d, write %d", jobserver->read_fd, jobserver->write_fd);
+    return jobserver;
+}
+
+bool tryAcquireJobToken(Jobserver* jobserver, char* token) {
+    if (jobserver->read_fd<0)
+        return false;
+    if (!jobserver->read_nonblocking) {
+        // another process can still take the token between the poll and the read, in which case the read waits for the next one
+        struct pollfd poll_fd = {
+            .fd = jobserver->read_fd,
+            .events = POLLIN,
+        };
+        if (poll(&poll_fd, 1U, 0)<=0 || !(poll_fd.revents & POLLIN))
+            return false;
+    }
+    ssize_t num_read;
+    do {
+        num_read = read(jobserver->read_fd, token, 1U);
+    } while (num_read<0 && errno==EINTR);
+    return num_read==1;
+}
+
+void releaseJobToken(Jobserver* jobserver, char token) {
+    ssize_t num_written;
+    do {
+        num_written = write(jobserver->write_fd, &token, 1U);
+    } while (num_written<0 && errno==EINTR);
+    if (UNLIKELY(num_written!=1))
+        myErrorErrno("could not give a token back to the jobserver");
+}
+
+void disconnectJobserver(Jobserver* jobserver) {
+    if (jobserver->close_read)
+        close(jobserver->read_fd);
+    free(jobserver);
+}
+
+// the last one counts, since that's the one make added most recently
+static const char* findJobserverAuth(const char* makeflags, size_t* length) {
+    static const char *const prefixes[] = {"--jobserver-auth=", "--jobserver-fds="};
+    const char *ret = NULL;
+    const char *c = makeflags;
+    while (*c!='\0') {
+        while (*c==' ')
+            c++;
+        const char *word = c;
+        while (*c!=' ' && *c!='\0')
+            c++;
+        const size_t word_length = (size_t)(c-word);
+        for (size_t i=0U; i<sizeof(prefixes)/sizeof(prefixes[0]); i++) {
+            const size_t prefix_length = strlen(prefixes[i]);
+            if (word_length>prefix_length && memcmp(word, prefixes[i], prefix_length)==0) {
+                ret = word + prefix_length;
+                *length = word_length - prefix_length;
+            }
+        }
+    }
+    return ret;
+}
+
+// not parseUint32, since a bad value here just means there's no jobserver rather than being fatal
+static bool parseJobserverFds(const char* auth, size_t length, int* read_fd, int* write_fd) {
+    int *fd = read_fd;
+    *read_fd = *write_fd = -1;
+    for (const char *c = auth; c!=&auth[length]; c++) {
+        if (*c==',' && fd==read_fd && *read_fd>=0)
+            fd = write_fd;
+        else if (*c>='0' && *c<='9' && (*fd<0 || *fd<=(INT_MAX-9)/10)) // make passes -2,-2 once it has closed them
+            *fd = (*fd<0 ? 0 : *fd*10) + (*c-'0');
+        else
+            return false;
+    }
+    return *write_fd>=0;
+}
+
+#else
+
+Jobserver* connectJobserver(void) {
+    return NULL;
+}
+
+// never called, since connectJobserver never returns a jobserver
+bool tryAcquireJobToken(Jobserver* jobserver ATTR_UNUSED, char* token ATTR_UNUSED) {
+    return false;
+}
+
+void releaseJobToken(Jobserver* jobserver ATTR_UNUSED, char token ATTR_UNUSED) {
+}
+
+void disconnectJobserver(Jobserver* jobserver ATTR_UNUSED) {
+}
+
+#endif // ARRGEN_JOBSERVER_SUPPORTED
@@ -0,0 +1,56 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOBSERVER_H_INCLUDED
+#define JOBSERVER_H_INCLUDED
+#include "arrgen.h"
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// a connection to the jobserver of the GNU make running arrgen, if there is one.
+// every process make starts already has one job slot of its own, a token from the jobserver is needed for each one beyond that
+typedef struct Jobserver Jobserver;
+
+/**
+ * @brief looks for --jobserver-auth (or the older --jobserver-fds) in MAKEFLAGS, in either the fifo:PATH or the R,W form.
+ * if make passed it but the pipe isn't open in this process, which is what make does for commands it doesn't think
+ * are recursive makes, the result is a jobserver that never hands out tokens, so arrgen only uses the one slot it has
+ * @return NULL if not running under a make with a jobserver, or if jobservers aren't supported in this build
+*/
+Jobserver* connectJobserver(void);
+
+/**
+ * @brief takes a token if one is available right now, without waiting for one
+ * @param token set to the token taken, which has to be given back with releaseJobToken
+ * @return true if a token was taken
+*/
+bool tryAcquireJobToken(Jobserver* jobserver, char* token)
+    ATTR_ACCESS(write_only, 2)
+    ATTR_NONNULL;
+
+void releaseJobToken(Jobserver* jobserver, char token)
+    ATTR_NONNULL;
+
+void disconnectJobserver(Jobserver* jobserver)
+    ATTR_NONNULL;
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // JOBSERVER_H_INCLUDED
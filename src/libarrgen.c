@@ -0,0 +1,257 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arrgen.h"
+#include "libarrgen.h"
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "errors.h"
+#include "parameters.h"
+#include "handlefile.h"
+#include "writearray.h"
+#include "c_string_stuff.h"
+
+struct ArrgenContext {
+    OutputFileParams *params;
+    size_t params_size;
+    InputFileParams defaults;
+    char *settings_file; // what params->params_file points to, if a settings file was loaded
+    char *errors;
+    // the thread-local parameters from before the current call, to put back afterwards
+    OutputFileParams *saved_params;
+    size_t saved_params_size;
+    InputFileParams saved_defaults;
+};
+
+// every function here switches the thread-local parameters the rest of arrgen uses over to the context's, and
+// back when it's done. the setjmp has to be in each function itself, since it can't be returned from
+static void enterContext(ArrgenContext* context, jmp_buf* fatal_jump)
+    ATTR_NONNULL;
+
+static bool leaveContext(ArrgenContext* context, bool succeeded)
+    ATTR_NONNULL;
+
+static FILE* openMemoryOutput(char** output, size_t* output_length)
+    ATTR_NONNULL;
+
+static bool closeMemoryOutput(FILE* out, char** output, size_t* output_length)
+    ATTR_NONNULL;
+
+ArrgenContext* arrgenCreateContext(void) {
+    // volatile since it's used after the longjmp
+    ArrgenContext *volatile context = calloc(1U, sizeof(ArrgenContext));
+    if (UNLIKELY(context==NULL))
+        return NULL;
+    jmp_buf fatal_jump;
+    OutputFileParams *saved_params = params_;
+    size_t saved_params_size = current_params_size_;
+    InputFileParams saved_defaults = defaults_;
+    captureErrors(&fatal_jump);
+    if (setjmp(fatal_jump)==0) {
+        initializeParams();
+        context->params = params_;
+        context->params_size = current_params_size_;
+        context->defaults = defaults_;
+    }
+    free(stopCapturingErrors());
+    params_ = saved_params;
+    current_params_size_ = saved_params_size;
+    defaults_ = saved_defaults;
+    if (UNLIKELY(context->params==NULL)) {
+        free(context);
+        return NULL;
+    }
+    return context;
+}
+
+void arrgenDestroyContext(ArrgenContext* context) {
+    if (context==NULL)
+        return;
+    freeParams(context->params, &context->defaults);
+    free(context->settings_file);
+    free(context->errors);
+    free(context);
+}
+
+bool arrgenSetParameter(ArrgenContext* context, const char* parameter) {
+    jmp_buf fatal_jump;
+    volatile bool ret = false;
+    enterContext(context, &fatal_jump);
+    if (setjmp(fatal_jump)==0) {
+        if (UNLIKELY(!parseParameterLine(parameter, false)))
+            myFatal("%s: unknown parameter", parameter);
+        ret = true;
+    }
+    return leaveContext(context, ret);
+}
+
+bool arrgenAddInput(ArrgenContext* context, const char* path) {
+    jmp_buf fatal_jump;
+    volatile bool ret = false;
+    enterContext(context, &fatal_jump);
+    if (setjmp(fatal_jump)==0) {
+        newInputFile(path, false);
+        ret = true;
+    }
+    return leaveContext(context, ret);
+}
+
+bool arrgenLoadSettingsFile(ArrgenContext* context, const char* path) {
+    jmp_buf fatal_jump;
+    volatile bool ret = false;
+    enterContext(context, &fatal_jump);
+    if (setjmp(fatal_jump)==0) {
+        if (UNLIKELY(params_->params_file!=NULL || params_->num_inputs>0U))
+            myFatal("%s: can only load a settings file before any inputs are given", path);
+        context->settings_file = duplicateString(path);
+        params_->params_file = context->settings_file;
+        parseParamsFile(path);
+        ret = true;
+    }
+    return leaveContext(context, ret);
+}
+
+bool arrgenGenerate(ArrgenContext* context) {
+    jmp_buf fatal_jump;
+    volatile bool ret = false;
+    enterContext(context, &fatal_jump);
+    if (setjmp(fatal_jump)==0) {
+        if (UNLIKELY(params_->num_inputs==0U))
+            myFatal("no inputs given");
+        finishParams();
+        ret = handleFile(params_);
+    }
+    return leaveContext(context, ret);
+}
+
+bool arrgenFormatBuffer(ArrgenContext* context, const void* buf, size_t length, const char* array_name, char** output, size_t* output_length) {
+    jmp_buf fatal_jump;
+    volatile bool ret = false;
+    FILE *volatile out = NULL;
+    *output = NULL;
+    *output_length = 0U;
+    enterContext(context, &fatal_jump);
+    if (setjmp(fatal_jump)==0) {
+        const InputFileParams *settings = &defaults_;
+        initializeLookup(settings->base, settings->aligned);
+        out = openMemoryOutput(output, output_length);
+        if (array_name!=NULL) {
+            fputs((settings->attributes==NULL ? "" : settings->attributes), out);
+            writeArrayPlacement(out, settings, array_name, true);
+            fprintf(out,
+                "%sunsigned char %s[%zu] = {",
+                (settings->make_const ? "const " : ""),
+                array_name,
+                paddedLength(settings, length));
+        }
+        ssize_t cur_line_pos = -1;
+        writeArrayContents(out, (const uint8_t*)buf, length, &cur_line_pos, settings->line_length);
+        if (array_name!=NULL) {
+            writeArrayPadding(out, settings, length);
+            fprintf(out, "};\n");
+        }
+        FILE *to_close = out;
+        out = NULL;
+        ret = closeMemoryOutput(to_close, output, output_length);
+    }
+    if (UNLIKELY(out!=NULL))
+        fclose(out);
+    if (!ret) {
+        free(*output);
+        *output = NULL;
+        *output_length = 0U;
+    }
+    return leaveContext(context, ret);
+}
+
+const char* arrgenErrors(const ArrgenContext* context) {
+    return context->errors;
+}
+
+static void enterContext(ArrgenContext* context, jmp_buf* fatal_jump) {
+    context->saved_params = params_;
+    context->saved_params_size = current_params_size_;
+    context->saved_defaults = defaults_;
+    params_ = context->params;
+    current_params_size_ = context->params_size;
+    defaults_ = context->defaults;
+    captureErrors(fatal_jump);
+}
+
+static bool leaveContext(ArrgenContext* context, bool succeeded) {
+    // params_ moves if newInputFile had to make room for more inputs
+    context->params = params_;
+    context->params_size = current_params_size_;
+    context->defaults = defaults_;
+    params_ = context->saved_params;
+    current_params_size_ = context->saved_params_size;
+    defaults_ = context->saved_defaults;
+    // a fatal error longjmps past whatever was open at the time
+    if (!succeeded) {
+        abandonParamsFile();
+        abandonHandleFile();
+    }
+    free(context->errors);
+    context->errors = stopCapturingErrors();
+    return succeeded;
+}
+
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+static FILE* openMemoryOutput(char** output, size_t* output_length) {
+    FILE *out = open_memstream(output, output_length);
+    if (UNLIKELY(out==NULL))
+        myFatalErrno("open_memstream");
+    return out;
+}
+
+static bool closeMemoryOutput(FILE* out, char** output ATTR_UNUSED, size_t* output_length ATTR_UNUSED) {
+    // fclose is what sets output and output_length for the last time
+    if (UNLIKELY(fclose(out)!=0)) {
+        myErrorErrno("could not write to memory");
+        return false;
+    }
+    return true;
+}
+#else
+// no open_memstream, so go through a temporary file instead
+static FILE* openMemoryOutput(char** output ATTR_UNUSED, size_t* output_length ATTR_UNUSED) {
+    FILE *out = tmpfile();
+    if (UNLIKELY(out==NULL))
+        myFatalErrno("tmpfile");
+    return out;
+}
+
+static bool closeMemoryOutput(FILE* out, char** output, size_t* output_length) {
+    long length = ftell(out);
+    bool ret = (length>=0L && !ferror(out));
+    if (LIKELY(ret)) {
+        *output = malloc((size_t)length+1U);
+        if (UNLIKELY(*output==NULL))
+            myFatalErrno("failed to allocate %ld bytes", length+1L);
+        rewind(out);
+        ret = (fread(*output, 1, (size_t)length, out)==(size_t)length);
+        (*output)[length] = '\0';
+        *output_length = (size_t)length;
+    }
+    if (UNLIKELY(!ret))
+        myErrorErrno("could not write to temporary file");
+    fclose(out);
+    return ret;
+}
+#endif
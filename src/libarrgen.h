@@ -0,0 +1,88 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBARRGEN_H_INCLUDED
+#define LIBARRGEN_H_INCLUDED
+#include <stdbool.h>
+#include <stddef.h>
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// the interface to use arrgen from another program, without running it as a separate process. link with libarrgen.a (and -pthread).
+// none of these functions print anything or quit, errors are returned instead.
+// a context can only be used by one thread at a time, but different threads can use different contexts at the same time.
+// after a fatal error (like running out of memory) in the middle of a call, the files it had open are closed and its temporary
+// files are removed before it returns. a few smaller allocations (like the buffer for an input being transformed) can still leak
+
+// the parameters and inputs given so far, and the errors from the last call
+typedef struct ArrgenContext ArrgenContext;
+
+/**
+ * @brief creates a context with every parameter at its default, and no inputs
+ * @return NULL if out of memory
+*/
+ArrgenContext* arrgenCreateContext(void);
+
+void arrgenDestroyContext(ArrgenContext* context);
+
+/**
+ * @brief the same as a %name=value line in a settings file: before the first input it sets a global parameter or
+ * the default for all inputs, after that it sets a parameter for the last input added. paths are relative to the current directory
+ * @param parameter like "base=16"
+ * @return false if the parameter is unknown or its value is invalid
+*/
+bool arrgenSetParameter(ArrgenContext* context, const char* parameter);
+
+/**
+ * @brief the same as an @path line in a settings file, but relative to the current directory
+*/
+bool arrgenAddInput(ArrgenContext* context, const char* path);
+
+/**
+ * @brief reads the parameters and inputs from a settings file, like arrgen -f. the context must not have any inputs yet
+*/
+bool arrgenLoadSettingsFile(ArrgenContext* context, const char* path);
+
+/**
+ * @brief generates the .c file and header (and the others, like the depfile, if their parameters were set) from the inputs, file to file
+ * @return false if anything failed. arrgenErrors says what
+*/
+bool arrgenGenerate(ArrgenContext* context);
+
+/**
+ * @brief formats a buffer in memory as array contents, using the base, aligned, line_length, const and attributes parameters given before the first input
+ * @param buf the bytes to format
+ * @param length the number of bytes in buf
+ * @param array_name if not NULL, the output is a whole array definition with this name, like in the generated .c file,
+ * including the section, alignment, pad_to and gc_sections parameters. otherwise it's just the comma-separated numbers
+ * @param output set to the text, allocated with malloc and null-terminated. the caller frees it. NULL on failure
+ * @param output_length set to the length of the text, not counting the null terminator
+*/
+bool arrgenFormatBuffer(ArrgenContext* context, const void* buf, size_t length, const char* array_name, char** output, size_t* output_length);
+
+/**
+ * @brief the error messages from the last call using context, one per line, or NULL if there weren't any.
+ * valid until the next call using context
+*/
+const char* arrgenErrors(const ArrgenContext* context);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // LIBARRGEN_H_INCLUDED
@@ -0,0 +1,336 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arrgen.h"
+#include "outputfile.h"
+#include <errno.h>
+#include <stdlib.h>
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+#   include <sys/stat.h>
+#   include <unistd.h>
+#   include <fcntl.h>
+#endif
+#include "errors.h"
+#include "c_string_stuff.h"
+#include "stats.h"
+#include "trace.h"
+#ifdef ARRGEN_THREADS_SUPPORTED
+#   include <pthread.h>
+#   include <stdatomic.h>
+static atomic_uint num_opened_ = 0U;
+static atomic_flag stdout_prepared_ = ATOMIC_FLAG_INIT;
+#else
+static unsigned num_opened_ = 0U;
+static bool stdout_prepared_ = false;
+#endif
+
+#ifndef ARRGEN_PIPE_SIZE
+#   define ARRGEN_PIPE_SIZE (1U<<20) // the most an unprivileged process can make a pipe by default on Linux
+#endif
+
+// the outputs open on every thread, so abandonOutputFiles can still find a thread's after a fatal error in libarrgen has
+// thrown away the stack frames their OutputFiles were in, and removeTempOutputFiles can find all of them
+typedef struct {
+    FILE* file;
+    char* temp_path;
+    const char* owner; // &owner_ on the thread that opened it
+} OpenOutput;
+static OpenOutput *open_outputs_ = NULL;
+static size_t num_open_outputs_ = 0U;
+#ifdef ARRGEN_THREADS_SUPPORTED
+static pthread_mutex_t open_outputs_mutex_ = PTHREAD_MUTEX_INITIALIZER;
+#endif
+// only its address is used, as something that's different on every thread
+static ARRGEN_THREAD_LOCAL char owner_;
+
+static bool contentsDiffer(FILE* temp, const char* path)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_NONNULL;
+
+static void prepareStdout(void);
+
+static void lockOpenOutputs(void);
+
+static void unlockOpenOutputs(void);
+
+static void rememberOpenOutput(FILE* file, char* temp_path)
+    ATTR_NONNULL_N(1);
+
+static void forgetOpenOutput(FILE* file)
+    ATTR_NONNULL;
+
+bool isStdoutPath(const char* path) {
+    return path[0]=='-' && path[1]=='\0';
+}
+
+FILE* openOutputFile(OutputFile* output, const char* path, bool check_only) {
+    output->path = path;
+    output->check_only = check_only;
+    output->to_stdout = isStdoutPath(path);
+    if (output->to_stdout) {
+        output->temp_path = NULL;
+        prepareStdout();
+        output->file = stdout;
+        return stdout;
+    }
+    if (check_only) {
+        // it's only compared with the real file, so it doesn't need a name, and the output directory can be read-only
+        output->temp_path = NULL;
+        output->file = tmpfile();
+        if (UNLIKELY(output->file==NULL))
+            myErrorErrno("%s: could not open a temporary file to check against", path);
+        else {
+            lockOpenOutputs();
+            rememberOpenOutput(output->file, NULL);
+            unlockOpenOutputs();
+        }
+        return output->file;
+    }
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+    // the pid keeps concurrent arrgen processes writing the same output from clobbering each other's temporary files,
+    // and the counter does the same for threads in one process (eg two manifests filling the same cache entry at once).
+    // using open instead of mkstemp so the permissions end up the same as if the file had been created with fopen
+    output->temp_path = sprintfAppend(NULL, "%s.%ld.%u.tmp", path, (long)getpid(), num_opened_++);
+    // created and remembered under the lock, so a fatal error on another thread can't miss it
+    lockOpenOutputs();
+    int fd = open(output->temp_path, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (UNLIKELY(fd<0 && errno==EEXIST)) {
+        // left over from an earlier run that died partway through
+        unlink(output->temp_path);
+        fd = open(output->temp_path, O_RDWR | O_CREAT | O_EXCL, 0666);
+    }
+    output->file = (LIKELY(fd>=0) ? fdopen(fd, "w+b") : NULL);
+    if (UNLIKELY(output->file==NULL && fd>=0)) {
+        close(fd);
+        unlink(output->temp_path);
+    }
+#else
+    output->temp_path = sprintfAppend(NULL, "%s.%u.tmp", path, num_opened_++);
+    lockOpenOutputs();
+    output->file = fopen(output->temp_path, "w+b"); // CLRF is icky
+#endif
+    if (LIKELY(output->file!=NULL))
+        rememberOpenOutput(output->file, output->temp_path);
+    unlockOpenOutputs();
+    if (UNLIKELY(output->file==NULL)) {
+        myErrorErrno("%s: could not open", output->temp_path);
+        free(output->temp_path);
+        output->temp_path = NULL;
+    }
+    DLOG("%s: writing to %s", path, output->temp_path);
+    return output->file;
+}
+
+bool closeOutputFile(OutputFile* output, bool write_succeeded) {
+    const double write_start = statsNow();
+    const double trace_start = traceNow();
+    bool ret = write_succeeded;
+    if (output->to_stdout) {
+        // whatever's been written is already gone, so there's nothing to throw away or replace
+        if (UNLIKELY(fflush(stdout)!=0 || ferror(stdout))) {
+            myErrorErrno("stdout: could not write");
+            ret = false;
+        }
+        output->file = NULL;
+        statsAddTime(STATS_WRITE, write_start);
+        traceSpan("write", output->path, trace_start);
+        return ret;
+    }
+    forgetOpenOutput(output->file);
+    // where the error messages say it was being written
+    const char *written_path = (output->temp_path!=NULL ? output->temp_path : output->path);
+    bool replace = false;
+    if (UNLIKELY(fflush(output->file)!=0 || ferror(output->file))) {
+        myErrorErrno("%s: could not write", written_path);
+        ret = false;
+    }
+    if (ret && contentsDiffer(output->file, output->path)) {
+        if (output->check_only) {
+            myError("%s: out of date", output->path);
+            ret = false;
+        } else
+            replace = true;
+    }
+    if (UNLIKELY(fclose(output->file)!=0)) {
+        myErrorErrno("%s: could not close", written_path);
+        ret = false;
+        replace = false;
+    }
+    bool replaced = false;
+    if (replace) {
+#if defined(_WIN32) || defined(_WIN64)
+        // rename doesn't overwrite on Windows
+        remove(output->path);
+#endif
+        replaced = LIKELY(rename(output->temp_path, output->path)==0);
+        if (UNLIKELY(!replaced)) {
+            myErrorErrno("%s: could not rename to %s", output->temp_path, output->path);
+            ret = false;
+        }
+    } else {
+        DLOG("%s: not replacing (ret %hhu)", output->path, ret);
+    }
+    if (!replaced && output->temp_path!=NULL && UNLIKELY(remove(output->temp_path)!=0))
+        myErrorErrno("%s: could not remove", output->temp_path);
+    free(output->temp_path);
+    output->temp_path = NULL;
+    output->file = NULL;
+    statsAddTime(STATS_WRITE, write_start);
+    traceSpan("write", output->path, trace_start);
+    return ret;
+}
+
+static bool contentsDiffer(FILE* temp, const char* path) {
+    FILE* existing = fopen(path, "rb");
+    if (existing==NULL)
+        return true;
+    // cheap check first, most changes change the size
+    long temp_size = ftell(temp);
+    bool ret = (fseek(existing, 0, SEEK_END)!=0 || ftell(existing)!=temp_size);
+    if (!ret) {
+        uint8_t *bufs = malloc(2U*ARRGEN_BUFFER_SIZE);
+        if (UNLIKELY(bufs==NULL))
+            myFatalErrno("failed to allocate %u bytes", 2U*ARRGEN_BUFFER_SIZE);
+        rewind(temp);
+        rewind(existing);
+        size_t num_read;
+        do {
+            num_read = fread(bufs, 1, ARRGEN_BUFFER_SIZE, temp);
+            ret = (fread(&bufs[ARRGEN_BUFFER_SIZE], 1, ARRGEN_BUFFER_SIZE, existing)!=num_read
+                || memcmp(bufs, &bufs[ARRGEN_BUFFER_SIZE], num_read)!=0);
+        } while (!ret && num_read==ARRGEN_BUFFER_SIZE);
+        // a read error on either one means the existing file can't be trusted to be the same
+        ret = ret || ferror(temp) || ferror(existing);
+        free(bufs);
+    }
+    fclose(existing);
+    DLOG("%s: contents %s", path, ret ? "differ" : "unchanged");
+    return ret;
+}
+
+// stdout is usually a pipe to the compiler here, so it's written a whole pipe's worth at a time, and the pipe is made as big as
+// it can be so the compiler can keep reading while the next buffer is formatted
+static void prepareStdout(void) {
+    static char buf[ARRGEN_PIPE_SIZE];
+    // setvbuf can only be called before anything is written. libarrgen contexts on different threads could both get here
+#ifdef ARRGEN_THREADS_SUPPORTED
+    if (atomic_flag_test_and_set(&stdout_prepared_))
+        return;
+#else
+    if (stdout_prepared_)
+        return;
+    stdout_prepared_ = true;
+#endif
+    size_t buf_size = ARRGEN_BUFFER_SIZE;
+#if defined(__linux__) && defined(F_SETPIPE_SZ)
+    // both fail if stdout isn't a pipe, which is fine
+    if (fcntl(STDOUT_FILENO, F_SETPIPE_SZ, (int)ARRGEN_PIPE_SIZE)<0) {
+        DLOG("F_SETPIPE_SZ: %s", strerror(errno));
+    }
+    int pipe_size = fcntl(STDOUT_FILENO, F_GETPIPE_SZ);
+    if (pipe_size>0)
+        buf_size = (size_t)pipe_size;
+#endif
+    if (buf_size>ARRGEN_PIPE_SIZE)
+        buf_size = ARRGEN_PIPE_SIZE;
+    DLOG("stdout buffer of %zu bytes", buf_size);
+    if (UNLIKELY(setvbuf(stdout, buf, _IOFBF, buf_size)!=0))
+        myErrorErrno("stdout: could not set buffer");
+}
+
+void abandonOutputFiles(void) {
+    lockOpenOutputs();
+    for (size_t i=0U; i<num_open_outputs_; ) {
+        if (open_outputs_[i].owner!=&owner_) {
+            i++;
+            continue;
+        }
+        DLOG("%s: abandoning", open_outputs_[i].temp_path!=NULL ? open_outputs_[i].temp_path : "anonymous file");
+        fclose(open_outputs_[i].file);
+        if (open_outputs_[i].temp_path!=NULL && UNLIKELY(remove(open_outputs_[i].temp_path)!=0))
+            myErrorErrno("%s: could not remove", open_outputs_[i].temp_path);
+        free(open_outputs_[i].temp_path);
+        open_outputs_[i] = open_outputs_[--num_open_outputs_];
+    }
+    if (num_open_outputs_==0U) {
+        free(open_outputs_);
+        open_outputs_ = NULL;
+    }
+    unlockOpenOutputs();
+}
+
+void removeTempOutputFiles(void) {
+    // never unlocked, so no other thread can start another output before the program quits
+    lockOpenOutputs();
+    // the other threads could still be writing to theirs, so they're left open, and it's quitting anyway
+    for (size_t i=0U; i<num_open_outputs_; i++) {
+        if (open_outputs_[i].temp_path!=NULL) {
+            DLOG("%s: removing", open_outputs_[i].temp_path);
+            remove(open_outputs_[i].temp_path);
+        }
+    }
+    num_open_outputs_ = 0U;
+}
+
+// the caller holds the lock
+static void rememberOpenOutput(FILE* file, char* temp_path) {
+    // there are only ever a few open at once, so growing one at a time is fine
+    OpenOutput *open_outputs = realloc(open_outputs_, sizeof(OpenOutput)*(num_open_outputs_+1U));
+    if (UNLIKELY(open_outputs==NULL)) {
+        // not remembered, so nothing else would remove it
+        unlockOpenOutputs();
+        fclose(file);
+        if (temp_path!=NULL)
+            remove(temp_path);
+        myFatalErrno("failed to allocate %zu bytes", sizeof(OpenOutput)*(num_open_outputs_+1U));
+    }
+    open_outputs_ = open_outputs;
+    open_outputs_[num_open_outputs_++] = (OpenOutput) {
+        .file = file,
+        .temp_path = temp_path,
+        .owner = &owner_,
+    };
+}
+
+static void forgetOpenOutput(FILE* file) {
+    lockOpenOutputs();
+    for (size_t i=0U; i<num_open_outputs_; i++) {
+        if (open_outputs_[i].file==file) {
+            open_outputs_[i] = open_outputs_[--num_open_outputs_];
+            break;
+        }
+    }
+    // freed when empty, so it isn't left behind when the last output is closed
+    if (num_open_outputs_==0U) {
+        free(open_outputs_);
+        open_outputs_ = NULL;
+    }
+    unlockOpenOutputs();
+}
+
+static void lockOpenOutputs(void) {
+#ifdef ARRGEN_THREADS_SUPPORTED
+    pthread_mutex_lock(&open_outputs_mutex_);
+#endif
+}
+
+static void unlockOpenOutputs(void) {
+#ifdef ARRGEN_THREADS_SUPPORTED
+    pthread_mutex_unlock(&open_outputs_mutex_);
+#endif
+}
@@ -0,0 +1,84 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUTPUTFILE_H_INCLUDED
+#define OUTPUTFILE_H_INCLUDED
+#include "arrgen.h"
+#include <stdio.h>
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// Generated files are written to a temporary file next to the real one, which only replaces the real one if the contents differ.
+// That way the mtime of an unchanged output stays the same, and nothing that depends on it gets rebuilt. In check_only mode
+// they're written to an anonymous temporary file instead, so nothing is created next to the outputs.
+typedef struct {
+    FILE* file;
+    const char* path; // the path the output will end up at
+    char* temp_path; // the file actually being written, or NULL if it has no name
+    bool check_only; // never replace the real file, just report whether it would have been
+    bool to_stdout; // the path was -, so it's written straight to stdout with no temporary file
+} OutputFile;
+
+/**
+ * @brief whether path means stdout (ie it's -)
+*/
+bool isStdoutPath(const char* path)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_PURE
+    ATTR_NONNULL;
+
+/**
+ * @brief starts writing an output file. prints an error message on failure
+ * @param output the state to initialize, to be passed to closeOutputFile later
+ * @param path the path the output should end up at, or - for stdout. must stay valid until closeOutputFile
+ * @param check_only if true, the real file is never touched
+ * @return the file to write to, or NULL on failure
+*/
+FILE* openOutputFile(OutputFile* output, const char* path, bool check_only)
+    ATTR_ACCESS(write_only, 1)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_NONNULL;
+
+/**
+ * @brief finishes writing an output file. If everything was written successfully and the contents differ from the existing file, replaces it.
+ * Otherwise, deletes the temporary file. In check_only mode, prints a message if the file is out of date.
+ * @param output the state from openOutputFile
+ * @param write_succeeded false if the contents are incomplete and should be thrown away
+ * @return false if anything failed, or if check_only was given and the file is out of date
+*/
+bool closeOutputFile(OutputFile* output, bool write_succeeded)
+    ATTR_ACCESS(read_write, 1)
+    ATTR_NONNULL;
+
+/**
+ * @brief closes every output opened on this thread that hasn't been closed yet, and removes their temporary files.
+ * only for cleaning up after a fatal error, since the OutputFiles can't be used after
+*/
+void abandonOutputFiles(void);
+
+/**
+ * @brief removes the temporary files of every output still open, on any thread. only for just before quitting on a fatal
+ * error, since it leaves the outputs unusable, and any thread that tries to open or close one after waits forever
+*/
+void removeTempOutputFiles(void);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // OUTPUTFILE_H_INCLUDED
@@ -20,22 +20,311 @@
 #include "parameters.h"
 #include "errors.h"
 #include "c_string_stuff.h"
+#include "inputglob.h"
+#include "tararchive.h"
+#include "transform.h"
+#include "outputfile.h"
+#include <ctype.h>
+#include <errno.h>
 #include <stdlib.h>
 
-OutputFileParams *params_ = NULL; // allocated to the below size at the start of main
-size_t current_params_size_ = sizeof(OutputFileParams) + sizeof(InputFileParams)*1;
-InputFileParams defaults_ = {
+// thread-local so each manifest in batch mode can be parsed and handled on its own thread
+ARRGEN_THREAD_LOCAL OutputFileParams *params_ = NULL; // allocated to the below size by initializeParams
+ARRGEN_THREAD_LOCAL size_t current_params_size_ = sizeof(OutputFileParams) + sizeof(InputFileParams)*1;
+ARRGEN_THREAD_LOCAL InputFileParams defaults_; // set to the below by initializeParams
+
+static const InputFileParams initial_defaults_ = {
     .path_original = NULL,
     .path_to_open = NULL,
     .length_name = NULL,
     .array_name = NULL,
     .attributes = NULL,
     .line_length = 0U,
+    .split_size = 0U,
     .base = 10U,
+    .checksums = 0U,
+    .transform = ARRGEN_TRANSFORM_NONE,
+    .section = NULL,
+    .alignment = 0U,
+    .pad_to = 0U,
+    .gc_sections = false,
     .aligned = false, // whether or not to print numbers in fixed-width columns
     .make_const = true,
+    .from_archive = false,
 };
 
+// the index of the last tar archive used in the settings file, so listing several of its members one at a time only reads it once
+static ARRGEN_THREAD_LOCAL char *indexed_archive_path_ = NULL;
+static ARRGEN_THREAD_LOCAL TarMember *indexed_archive_members_ = NULL;
+static ARRGEN_THREAD_LOCAL size_t indexed_archive_num_members_ = 0U;
+// the settings file being read, kept here rather than on the stack so abandonParamsFile can close it after a fatal error in libarrgen
+static ARRGEN_THREAD_LOCAL FILE *params_file_in_ = NULL;
+static ARRGEN_THREAD_LOCAL char *params_file_buf_ = NULL;
+
+static void forgetArchiveIndex(void);
+
+static void newArchiveMemberInput(const char* archive_path, const char* archive_path_to_open, const TarMember* member)
+    ATTR_NONNULL;
+
+void initializeParams(void) {
+    defaults_ = initial_defaults_;
+    current_params_size_ = sizeof(OutputFileParams) + sizeof(InputFileParams)*1;
+    params_ = malloc(current_params_size_);
+    if (UNLIKELY(params_==NULL))
+        myFatalErrno("failed to allocate %zu bytes", current_params_size_);
+    params_->c_path = NULL;
+    params_->h_name = NULL;
+    params_->header_top_text = NULL;
+    params_->params_file = NULL;
+    params_->output_list = NULL;
+    params_->depfile = NULL;
+    params_->cache_dir = NULL;
+    params_->external_data = NULL;
+    params_->external_data_name = NULL;
+    params_->module_name = NULL;
+    params_->header_includes = NULL;
+    params_->num_header_includes = 0U;
+    params_->extra_headers = NULL;
+    params_->num_extra_headers = 0U;
+    params_->path_prefix_maps = NULL;
+    params_->num_path_prefix_maps = 0U;
+    params_->num_shards = 1U;
+    params_->create_header = true;
+    params_->constexpr_length = false;
+    params_->cpp_constexpr = false;
+    params_->extern_length = false;
+    params_->header_per_input = false;
+    params_->reproducible = false;
+    params_->check_only = false;
+    params_->arena = (Arena) {
+        .blocks = NULL,
+    };
+    params_->first_input_of_entry = 0U;
+    params_->num_inputs = 0;
+}
+
+static void checkUniqueNames(void);
+
+static int compareNames(const void* a, const void* b)
+    ATTR_PURE
+    ATTR_NONNULL;
+
+void finishParams(void) {
+    Arena *arena = &params_->arena;
+    forgetArchiveIndex();
+    if (params_->c_path == NULL)
+        params_->c_path = arenaDuplicateString(arena, DEFAULT_C_PATH);
+    if (params_->h_name == NULL)
+        params_->h_name = (params_->module_name!=NULL ? arenaSprintfAppend(arena, NULL, "%s.cppm", params_->module_name) : arenaDuplicateString(arena, DEFAULT_H_NAME));
+    // a module has the arrays in it the same way, it's just exported instead of included
+    if (params_->module_name!=NULL)
+        params_->cpp_constexpr = true;
+    if (UNLIKELY(params_->constexpr_length && params_->extern_length))
+        myFatal("cannot use both constexpr_length and extern_length");
+    if (params_->external_data!=NULL) {
+        if (UNLIKELY(isStdoutPath(params_->external_data)))
+            myFatal("external_data has to be a file, it's written out of order");
+        // the lengths come from the pack when the program runs
+        if (UNLIKELY(params_->constexpr_length))
+            myFatal("cannot use both constexpr_length and external_data");
+        const char *last_slash = strrchr(params_->external_data, '/');
+        const char *pack_name = (last_slash==NULL ? params_->external_data : last_slash+1);
+        params_->external_data_name = arenaCreateCName(arena, pack_name, strlen(pack_name), "");
+    }
+    if (params_->cpp_constexpr) {
+        // everything is in the header, so it has to be there, and it has to have the lengths before the arrays are used
+        if (UNLIKELY(!params_->create_header))
+            myFatal("cpp_constexpr needs create_header, there's no .c file");
+        if (UNLIKELY(params_->extern_length))
+            myFatal("cannot use both cpp_constexpr and extern_length");
+        if (UNLIKELY(params_->external_data!=NULL))
+            myFatal("cannot use both cpp_constexpr and external_data");
+        for (size_t i=0U; i<params_->num_inputs; i++)
+            if (UNLIKELY(params_->inputs[i].split_size!=0U))
+                myFatal("%s: cannot split inputs with cpp_constexpr", params_->inputs[i].path_original);
+        params_->constexpr_length = true;
+    }
+    if (isStdoutPath(params_->c_path)) {
+        // everything has to go in the one stream, and there's nothing there to compare with
+        if (UNLIKELY(params_->num_shards!=1U))
+            myFatal("cannot use shards when writing the .c file to stdout");
+        if (UNLIKELY(params_->check_only))
+            myFatal("cannot check whether stdout is out of date");
+        if (UNLIKELY(params_->depfile!=NULL && !params_->create_header))
+            myFatal("%s: nothing would be written to a file for the depfile to list", params_->depfile);
+        for (size_t i=0U; i<params_->num_inputs; i++)
+            if (UNLIKELY(params_->inputs[i].split_size!=0U))
+                myFatal("%s: cannot split inputs when writing the .c file to stdout", params_->inputs[i].path_original);
+    }
+
+    // put together all at once rather than a line per parameter, so the extra_header strings allocated in between don't
+    // make each line copy all of the text before it
+    params_->header_top_text = NULL;
+    for (size_t i=0U; i<params_->num_header_includes; i++)
+        params_->header_top_text = arenaSprintfAppend(arena, params_->header_top_text, "#include %s\n", params_->header_includes[i]);
+
+    for (size_t i=0; i<params_->num_inputs; i++) {
+        InputFileParams *input = &params_->inputs[i];
+        // the chunks don't have a padded length of their own to go by
+        if (UNLIKELY(input->pad_to>1U && input->split_size!=0U))
+            myFatal("%s: cannot use both pad_to and split_size", input->path_original);
+        if (input->array_name!=NULL && input->length_name!=NULL)
+            continue;
+        // always from the path as given, even in reproducible mode, since the names are what the program using them refers to
+        const size_t path_length = strlen(input->path_original);
+        if (input->length_name==NULL) {
+            char *length_name = arenaCreateCName(arena, input->path_original, path_length, "_LENGTH");
+            input->length_name = length_name;
+            // the array name is the same, just without _LENGTH, so no need to convert the path twice
+            if (input->array_name==NULL)
+                input->array_name = arenaDuplicateStringLen(arena, length_name, strlen(length_name)-strlen("_LENGTH"));
+        } else
+            input->array_name = arenaCreateCName(arena, input->path_original, path_length, "");
+        // alignment null is fine
+    }
+    checkUniqueNames();
+}
+
+// two inputs with the same name would only be caught by the compiler, if at all (eg with header_per_input writing one header over the other)
+static void checkUniqueNames(void) {
+    if (params_->num_inputs<2U)
+        return;
+    const char **names = malloc(sizeof(char*)*params_->num_inputs);
+    if (UNLIKELY(names==NULL))
+        myFatalErrno("failed to allocate %zu bytes", sizeof(char*)*params_->num_inputs);
+    for (size_t i=0U; i<params_->num_inputs; i++)
+        names[i] = params_->inputs[i].array_name;
+    qsort(names, params_->num_inputs, sizeof(char*), compareNames);
+    for (size_t i=1U; i<params_->num_inputs; i++) {
+        if (UNLIKELY(!strcmp(names[i-1U], names[i]))) {
+            // the names themselves are in the arena, so they outlive the array
+            const char *name = names[i];
+            free(names);
+            myFatal("more than one input is named %s, give them different array_name", name);
+        }
+    }
+    free(names);
+}
+
+static int compareNames(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+static char* duplicateIfNonNull(const char* str);
+
+static char** duplicateStringArray(char* const* strs, size_t num)
+    ATTR_ACCESS(read_only, 1, 2);
+
+static char** appendToStringArray(char** strs, size_t num, char* str)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL_N(3);
+
+static size_t stringArrayCapacity(size_t num)
+    ATTR_CONST;
+
+static char* pathInArena(const char* path, bool from_params_file)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL;
+
+static bool literalInputExists(const char* path)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_NONNULL;
+
+void startParamsFrom(const OutputFileParams* template_params, const InputFileParams* template_defaults) {
+    current_params_size_ = sizeof(OutputFileParams) + sizeof(InputFileParams)*1;
+    params_ = malloc(current_params_size_);
+    if (UNLIKELY(params_==NULL))
+        myFatalErrno("failed to allocate %zu bytes", current_params_size_);
+    *params_ = *template_params;
+    // everything that gets freed with params_ has to be a copy in its own arena
+    params_->arena = (Arena) {
+        .blocks = NULL,
+    };
+    params_->c_path = duplicateIfNonNull(template_params->c_path);
+    params_->h_name = duplicateIfNonNull(template_params->h_name);
+    params_->header_top_text = NULL;
+    params_->output_list = duplicateIfNonNull(template_params->output_list);
+    params_->depfile = duplicateIfNonNull(template_params->depfile);
+    params_->cache_dir = duplicateIfNonNull(template_params->cache_dir);
+    params_->external_data = duplicateIfNonNull(template_params->external_data);
+    params_->module_name = duplicateIfNonNull(template_params->module_name);
+    params_->header_includes = duplicateStringArray(template_params->header_includes, template_params->num_header_includes);
+    params_->extra_headers = duplicateStringArray(template_params->extra_headers, template_params->num_extra_headers);
+    params_->path_prefix_maps = duplicateStringArray(template_params->path_prefix_maps, template_params->num_path_prefix_maps);
+    params_->num_inputs = 0U;
+    defaults_ = *template_defaults;
+    defaults_.attributes = duplicateIfNonNull(template_defaults->attributes);
+    defaults_.section = duplicateIfNonNull(template_defaults->section);
+}
+
+void freeParams(OutputFileParams* params, InputFileParams* defaults) {
+    // in case the settings were never finished, because of an error in libarrgen
+    forgetArchiveIndex();
+    // everything else belonging to params is in the arena. params_file belongs to whoever set it
+    DLOG("arena");
+    freeArena(&params->arena);
+    defaults->attributes = NULL;
+    DLOG("params");
+    free(params);
+}
+
+static char* duplicateIfNonNull(const char* str) {
+    return (str==NULL ? NULL : arenaDuplicateString(&params_->arena, str));
+}
+
+static char** duplicateStringArray(char* const* strs, size_t num) {
+    if (num==0U)
+        return NULL;
+    char **ret = arenaAlloc(&params_->arena, sizeof(char*)*stringArrayCapacity(num));
+    for (size_t i=0U; i<num; i++)
+        ret[i] = arenaDuplicateString(&params_->arena, strs[i]);
+    return ret;
+}
+
+// the capacity doubles whenever it's full, so adding to an array a string at a time stays linear. the old arrays stay in the arena
+static char** appendToStringArray(char** strs, size_t num, char* str) {
+    if (num==stringArrayCapacity(num)) {
+        char **grown = arenaAlloc(&params_->arena, sizeof(char*)*stringArrayCapacity(num+1U));
+        if (num>0U)
+            memcpy(grown, strs, sizeof(char*)*num);
+        strs = grown;
+    }
+    strs[num] = str;
+    return strs;
+}
+
+// the smallest power of 2 that's at least num, which is always how much room an array of num strings has
+static size_t stringArrayCapacity(size_t num) {
+    size_t ret = 1U;
+    while (ret<num)
+        ret *= 2U;
+    return (num==0U ? 0U : ret);
+}
+
+// the same as pathRelativeToFile (or just a copy, if it's not from a settings file), but in the arena
+static char* pathInArena(const char* path, bool from_params_file) {
+    if (!from_params_file)
+        return arenaDuplicateString(&params_->arena, path);
+    const char *last_slash = strrchr(params_->params_file, '/');
+    const int dir_length = (last_slash==NULL ? 0 : (int)(last_slash-params_->params_file)+1);
+    return arenaSprintfAppend(&params_->arena, NULL, "%.*s%s", dir_length, params_->params_file, path);
+}
+
+// so a settings file from before patterns, naming a file like icon[2x].png, still gets that file. fnmatch would take [2x] as a
+// set of characters and not match it
+static bool literalInputExists(const char* path) {
+    const size_t length = strlen(path);
+    if (length==0U || path[length-1U]=='/')
+        return false;
+    char *full_path = pathRelativeToFile(params_->params_file, path);
+    FILE *in = fopen(full_path, "rb");
+    free(full_path);
+    if (in==NULL)
+        return false;
+    fclose(in);
+    return true;
+}
+
 void newInputFile(const char* path, bool from_params_file) {
     params_->num_inputs++;
     size_t new_needed_size = sizeof(OutputFileParams) + sizeof(InputFileParams)*(params_->num_inputs);
@@ -48,12 +337,77 @@ void newInputFile(const char* path, bool from_params_file) {
         current_params_size_ = new_size;
     }
     InputFileParams *input = &params_->inputs[params_->num_inputs-1];
+    params_->first_input_of_entry = params_->num_inputs-1;
     // initialize to defaults
     *input = defaults_;
-    input->path_original = duplicateString(path);
-    if (defaults_.attributes!=NULL)
-        input->attributes = duplicateString(defaults_.attributes);
-    input->path_to_open = (from_params_file ? pathRelativeToFile(params_->params_file, path) : input->path_original);
+    // the attributes are shared with defaults_ until something is appended to them, which makes a copy. they can't be grown in
+    // place, since the path is always allocated after them
+    input->path_original = arenaDuplicateString(&params_->arena, path);
+    input->path_to_open = (from_params_file ? pathInArena(path, true) : input->path_original);
+}
+
+void newInputsFromPattern(const char* pattern) {
+    size_t num_matches;
+    char **matches = expandInputPattern(pattern, params_->params_file, &num_matches);
+    if (UNLIKELY(num_matches==0U))
+        myFatal("%s: %s: no files match", params_->params_file, pattern);
+    const size_t first = params_->num_inputs;
+    for (size_t i=0U; i<num_matches; i++) {
+        newInputFile(matches[i], true);
+        free(matches[i]);
+    }
+    free(matches);
+    params_->first_input_of_entry = first;
+}
+
+void newInputsFromArchive(const char* path, size_t archive_path_length) {
+    char *archive_path = duplicateStringLen(path, archive_path_length);
+    const char *archive_path_to_open = pathInArena(archive_path, true);
+    if (indexed_archive_path_==NULL || strcmp(indexed_archive_path_, archive_path_to_open)) {
+        forgetArchiveIndex();
+        indexed_archive_members_ = readTarIndex(archive_path_to_open, &indexed_archive_num_members_);
+        indexed_archive_path_ = duplicateString(archive_path_to_open);
+    }
+    const size_t first = params_->num_inputs;
+    const char *member_name = &path[archive_path_length+1U];
+    if (strcmp(member_name, "*")) {
+        // the same name can be in an archive more than once, and the last one is what extracting it would give
+        size_t i = indexed_archive_num_members_;
+        while (i>0U && strcmp(member_name, indexed_archive_members_[i-1U].name))
+            i--;
+        if (UNLIKELY(i==0U))
+            myFatal("%s: %s: no such file in %s", params_->params_file, member_name, archive_path_to_open);
+        newArchiveMemberInput(archive_path, archive_path_to_open, &indexed_archive_members_[i-1U]);
+    } else {
+        for (size_t i=0U; i<indexed_archive_num_members_; i++)
+            newArchiveMemberInput(archive_path, archive_path_to_open, &indexed_archive_members_[i]);
+        if (UNLIKELY(params_->num_inputs==first))
+            myFatal("%s: %s: no files in the archive", params_->params_file, archive_path_to_open);
+    }
+    free(archive_path);
+    params_->first_input_of_entry = first;
+}
+
+static void newArchiveMemberInput(const char* archive_path, const char* archive_path_to_open, const TarMember* member) {
+    // written archive:member in comments and names, so two archives with the same files in them don't clash
+    char *path = sprintfAppend(NULL, "%s:%s", archive_path, member->name);
+    newInputFile(path, false);
+    free(path);
+    InputFileParams *input = &params_->inputs[params_->num_inputs-1U];
+    input->path_to_open = archive_path_to_open;
+    input->from_archive = true;
+    input->archive_offset = member->offset;
+    input->archive_length = member->length;
+}
+
+static void forgetArchiveIndex(void) {
+    if (indexed_archive_path_==NULL)
+        return;
+    freeTarIndex(indexed_archive_members_, indexed_archive_num_members_);
+    free(indexed_archive_path_);
+    indexed_archive_path_ = NULL;
+    indexed_archive_members_ = NULL;
+    indexed_archive_num_members_ = 0U;
 }
 
 bool parseParameterLine(const char* arg, bool from_params_file) {
@@ -69,32 +423,150 @@ bool parseParameterLine(const char* arg, bool from_params_file) {
             myFatal("%s: global-only parameters must precede parameters specific to input files", arg);
         } else if (UNLIKELY(!parameter->valid_global))
             myFatal("%s: parameter must follow a specific input file", arg);
-        parameter->handler(equals_pos+1, defaults_end_reached ? &params_->inputs[params_->num_inputs-1] : &defaults_, from_params_file);
+        if (defaults_end_reached) {
+            // after a pattern, it applies to every file the pattern matched
+            if (UNLIKELY(params_->num_inputs-params_->first_input_of_entry>1U
+                    && (parameter->handler==registerArrayName || parameter->handler==registerLengthName)))
+                myFatal("%s: cannot give the same name to all %zu inputs matched by %s", arg, params_->num_inputs-params_->first_input_of_entry, params_->inputs[params_->first_input_of_entry].path_original);
+            for (size_t i=params_->first_input_of_entry; i<params_->num_inputs; i++)
+                parameter->handler(equals_pos+1, &params_->inputs[i], from_params_file);
+        } else
+            parameter->handler(equals_pos+1, &defaults_, from_params_file);
         return true;
     }
     return false;
 }
 
+#ifdef ARRGEN_GETLINE_SUPPORTED
+// path is only for the error about lines being too long, which getline doesn't have
+ssize_t readLine(char** buf, size_t* buf_size, FILE* in, const char* path ATTR_UNUSED) {
+    ssize_t num_read = getline(buf, buf_size, in);
+#else
+ssize_t readLine(char** buf, size_t* buf_size ATTR_UNUSED, FILE* in, const char* path) {
+    ssize_t num_read;
+    if (fgets(*buf, PATH_MAX, in)==NULL)
+        return -1;
+    num_read = strlen(*buf);
+    if (UNLIKELY(num_read>=(PATH_MAX-1)))
+        myFatal("%s: lines too long (system does not have GNU getline)", path);
+#endif
+    // remove the trailing newline if it's there
+    if (num_read>0 && (*buf)[num_read-1]=='\n') {
+        num_read--;
+        (*buf)[num_read] = '\0';
+    }
+    return num_read;
+}
+
+void parseParamsFile(const char* path) {
+    abandonParamsFile();
+    FILE* in = fopen(path, "rt");
+    if (UNLIKELY(in==NULL))
+        myFatalErrno("%s", path);
+    params_file_in_ = in;
+    size_t buf_size = PATH_MAX;
+    params_file_buf_ = malloc(buf_size);
+    if (UNLIKELY(params_file_buf_==NULL))
+        myFatalErrno("failed to allocate %zu bytes", buf_size);
+    ssize_t num_read;
+    unsigned cur_line = 0;
+    while (LIKELY((num_read = readLine(&params_file_buf_, &buf_size, in, path)) >= 0)) {
+        const char *buf = params_file_buf_;
+        cur_line++;
+        // skip empty lines
+        if (UNLIKELY(num_read==0))
+            continue;
+        // parse the line
+        switch (buf[0]) {
+        case '#': // it's a comment line
+            break;
+        case '@': { // it's an input file path, a pattern matching any number of them, or the files in a tar archive
+            size_t archive_path_length;
+            if (isTarInput(&buf[1], &archive_path_length))
+                newInputsFromArchive(&buf[1], archive_path_length);
+            else if (isInputPattern(&buf[1]) && !literalInputExists(&buf[1]))
+                newInputsFromPattern(&buf[1]);
+            else
+                newInputFile(&buf[1], true);
+            } break;
+        case '%': // it's a parameter
+            if (!parseParameterLine(&buf[1], true))
+                myFatal("%s: line %u: invalid parameter line %s", path, cur_line, buf);
+            break;
+        default: // it's invalid
+            myFatal("%s: %s: currently all non-empty lines must start with %% or #, try --help", path, buf);
+        }
+    }
+    int error = errno;
+    if (!LIKELY(feof(in))) {
+        errno = error;
+        myFatalErrno("%s", path);
+    }
+    abandonParamsFile();
+}
+
+void abandonParamsFile(void) {
+    if (params_file_in_!=NULL)
+        fclose(params_file_in_);
+    free(params_file_buf_);
+    params_file_in_ = NULL;
+    params_file_buf_ = NULL;
+}
+
 void registerCPath(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file) {
     if (UNLIKELY(params_->c_path!=NULL))
         myFatal("cannot give %s more than once", "c_path");
     // is there a point to asserting non-null? a segfault is already a strong assertion
     //assert(params_->params_file!=NULL);
-    params_->c_path = (from_params_file ? pathRelativeToFile(params_->params_file, str) : duplicateString(str));
+    // - is stdout wherever it's given
+    params_->c_path = pathInArena(str, from_params_file && !isStdoutPath(str));
+}
+
+void registerOutputList(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file) {
+    if (UNLIKELY(params_->output_list!=NULL))
+        myFatal("cannot give %s more than once", "output_list");
+    params_->output_list = pathInArena(str, from_params_file);
+}
+
+void registerDepfile(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file) {
+    if (UNLIKELY(params_->depfile!=NULL))
+        myFatal("cannot give %s more than once", "depfile");
+    params_->depfile = pathInArena(str, from_params_file);
+}
+
+void registerCacheDir(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file) {
+    if (UNLIKELY(params_->cache_dir!=NULL))
+        myFatal("cannot give %s more than once", "cache_dir");
+    params_->cache_dir = pathInArena(str, from_params_file);
+}
+
+void registerExternalData(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file) {
+    // empty is the same as not giving it
+    params_->external_data = (str[0]=='\0' ? NULL : pathInArena(str, from_params_file));
+}
+
+void registerShards(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED) {
+    if (!strcmp(str, "per_input"))
+        params_->num_shards = 0U;
+    else if (UNLIKELY((params_->num_shards = parseUint32(str, strlen(str)))==0U))
+        myFatal("shards must be per_input or at least 1");
 }
 
 void registerHName(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED) {
     if (UNLIKELY(params_->h_name!=NULL))
         myFatal("cannot give %s more than once", "h_name");
-    params_->h_name = duplicateString(str);
+    params_->h_name = arenaDuplicateString(&params_->arena, str);
 }
 
 void registerExtraHeader(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED) {
-    params_->header_top_text = sprintfAppend(params_->header_top_text, "#include \"%s\"\n", str);
+    char *include = arenaSprintfAppend(&params_->arena, NULL, "\"%s\"", str);
+    params_->header_includes = appendToStringArray(params_->header_includes, params_->num_header_includes++, include);
+    params_->extra_headers = appendToStringArray(params_->extra_headers, params_->num_extra_headers++, arenaDuplicateString(&params_->arena, str));
 }
 
 void registerExtraSystemHeader(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED) {
-    params_->header_top_text = sprintfAppend(params_->header_top_text, "#include <%s>\n", str);
+    char *include = arenaSprintfAppend(&params_->arena, NULL, "<%s>", str);
+    params_->header_includes = appendToStringArray(params_->header_includes, params_->num_header_includes++, include);
 }
 
 void registerCreateHeader(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED) {
@@ -104,23 +576,78 @@ void registerCreateHeader(const char* str, InputFileParams* params ATTR_UNUSED,
 void registerLengthName(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED) {
     if (UNLIKELY(params->length_name!=NULL))
         myFatal("cannot give %s for a target more than once", "length_name");
-    params->length_name = duplicateString(str);
+    params->length_name = arenaDuplicateString(&params_->arena, str);
 }
 
 void registerArrayName(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED) {
     if (UNLIKELY(params->length_name!=NULL))
         myFatal("cannot give %s for a target more than once", "array_name");
-    params->array_name = duplicateString(str);
+    params->array_name = arenaDuplicateString(&params_->arena, str);
 }
 
 void registerAttributes(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED) {
-    params->attributes = sprintfAppend(params->attributes, "%s\n", str);
+    params->attributes = arenaSprintfAppend(&params_->arena, params->attributes, "%s\n", str);
 }
 
 void registerLineLength(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED) {
     params->line_length = parseUint32(str, strlen(str));
 }
 
+void registerSplitSize(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED) {
+    params->split_size = parseUint32(str, strlen(str));
+}
+
+void registerChecksum(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED) {
+    params->checksums = 0U;
+    if (!strcmp(str, "none"))
+        return;
+    // a comma-separated list
+    for (const char *name=str; ; ) {
+        const char *comma = strchr(name, ',');
+        const size_t name_length = (comma==NULL ? strlen(name) : (size_t)(comma-name));
+        if (name_length==strlen("crc32c") && !strncmp(name, "crc32c", name_length))
+            params->checksums |= ARRGEN_CHECKSUM_CRC32C;
+        else if (name_length==strlen("xxh64") && !strncmp(name, "xxh64", name_length))
+            params->checksums |= ARRGEN_CHECKSUM_XXH64;
+        else
+            myFatal("invalid checksum %.*s, must be crc32c, xxh64 or none", (int)name_length, name);
+        if (comma==NULL)
+            break;
+        name = comma+1;
+    }
+}
+
+void registerTransform(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED) {
+    params->transform = parseTransform(str);
+}
+
+void registerSection(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED) {
+    // it goes in a string literal in the output
+    if (UNLIKELY(strpbrk(str, "\"\\")!=NULL))
+        myFatal("invalid section %s", str);
+    params->section = (str[0]=='\0' ? NULL : arenaDuplicateString(&params_->arena, str));
+}
+
+void registerAlignment(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED) {
+    if (!strcmp(str, "page"))
+        params->alignment = 4096U;
+    else if (!strcmp(str, "hugepage"))
+        params->alignment = 2U*1024U*1024U; // the size of an x86-64 or arm64 (with 4KiB pages) huge page
+    else {
+        params->alignment = parseUint32(str, strlen(str));
+        if (UNLIKELY((params->alignment & (params->alignment-1U))!=0U))
+            myFatal("alignment must be a power of 2, page or hugepage, not %s", str);
+    }
+}
+
+void registerPadTo(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED) {
+    params->pad_to = parseUint32(str, strlen(str));
+}
+
+void registerGcSections(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED) {
+    params->gc_sections = parseBool(str, "gc_sections");
+}
+
 void registerBase(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED) {
     if (!strcmp(str, "16"))
         params->base = 16U;
@@ -144,4 +671,40 @@ void registerConstexpr(const char* str, InputFileParams* params ATTR_UNUSED, boo
     params_->constexpr_length = parseBool(str, "constexpr_length");
 }
 
+void registerCppConstexpr(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED) {
+    params_->cpp_constexpr = parseBool(str, "cpp_constexpr");
+}
 
+void registerModuleName(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED) {
+    // identifiers separated by dots, the partitions' names get added after a colon
+    bool start = true;
+    for (const char* c=str; *c!='\0'; c++) {
+        if (*c=='.' && !start)
+            start = true;
+        else if (isalpha((unsigned char)*c) || *c=='_' || (!start && isdigit((unsigned char)*c)))
+            start = false;
+        else
+            myFatal("invalid module_name %s", str);
+    }
+    if (UNLIKELY(start))
+        myFatal("invalid module_name %s", str);
+    params_->module_name = arenaDuplicateString(&params_->arena, str);
+}
+
+void registerReproducible(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED) {
+    params_->reproducible = parseBool(str, "reproducible");
+}
+
+void registerPathPrefixMap(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED) {
+    if (UNLIKELY(strchr(str, '=')==NULL))
+        myFatal("path_prefix_map %s: must be in the form OLD=NEW", str);
+    params_->path_prefix_maps = appendToStringArray(params_->path_prefix_maps, params_->num_path_prefix_maps++, arenaDuplicateString(&params_->arena, str));
+}
+
+void registerExternLength(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED) {
+    params_->extern_length = parseBool(str, "extern_length");
+}
+
+void registerHeaderPerInput(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED) {
+    params_->header_per_input = parseBool(str, "header_per_input");
+}
@@ -20,6 +20,10 @@
 #define PARAMETERS_H_INCLUDED
 #include "arrgen.h"
 #include "handlefile.h"
+#include <stdio.h>
+
+#define DEFAULT_C_PATH "gen_arrays.c"
+#define DEFAULT_H_NAME "gen_arrays.h"
 
 typedef struct ArrgenParameter {
     int name_offset;
@@ -41,18 +45,89 @@ const struct ArrgenParameter* identifyParameter(register const char *str, regist
 
 // TODO find a cleaner solution that doesn't give current_params_size_ external linkage.
 // there's a lot of fan-out between parameters.c and parameters.h... can I clean this up? do I need to?
-extern OutputFileParams *params_;
-extern size_t current_params_size_; // current size of the allocated buffer for params
-extern InputFileParams defaults_;
+extern ARRGEN_THREAD_LOCAL OutputFileParams *params_;
+extern ARRGEN_THREAD_LOCAL size_t current_params_size_; // current size of the allocated buffer for params
+extern ARRGEN_THREAD_LOCAL InputFileParams defaults_;
+
+/**
+ * @brief reads a settings file into params_ and defaults_, quitting if there's anything wrong with it
+*/
+void parseParamsFile(const char* path)
+    ATTR_NONNULL;
+
+/**
+ * @brief closes the settings file parseParamsFile was reading on this thread, if a fatal error cut it short
+*/
+void abandonParamsFile(void);
+
+/**
+ * @brief reads a line with getline (or fgets if there's no getline), without the trailing newline
+ * @param path the file being read, for error messages
+ * @return the length of the line, or -1 at the end of the file or on error
+*/
+ssize_t readLine(char** buf, size_t* buf_size, FILE* in, const char* path)
+    ATTR_ACCESS(read_only, 4)
+    ATTR_NONNULL;
+
+/**
+ * @brief frees params and everything in it, and the attributes in defaults, except params_file
+*/
+void freeParams(OutputFileParams* params, InputFileParams* defaults)
+    ATTR_NONNULL;
+
+/**
+ * @brief allocates params_ and sets everything in it and defaults_ to the defaults, with no inputs
+*/
+void initializeParams(void);
+
+/**
+ * @brief fills in the defaults for anything that wasn't given once all the parameters have been read, like c_path and the
+ * array names, and checks that the parameters make sense together
+*/
+void finishParams(void);
+
+/**
+ * @brief sets params_ and defaults_ to copies of these, with no inputs yet, for a new settings file in batch mode.
+ * doesn't free what params_ was pointing to before
+*/
+void startParamsFrom(const OutputFileParams* template_params, const InputFileParams* template_defaults)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_NONNULL;
 
 // increment the number of inputs, and initialize the parameters of the newly added input file
 void newInputFile(const char* path, bool from_params_file)
     ATTR_NONNULL;
+/**
+ * @brief adds every file matching pattern (from an @ line in the settings file params_->params_file), in sorted order.
+ * the parameters after it apply to all of them. quits if nothing matches
+*/
+void newInputsFromPattern(const char* pattern)
+    ATTR_NONNULL;
+/**
+ * @brief adds the regular file in a tar archive named after the colon, or every one, in the order they're in the archive, for *.
+ * they're read straight out of the archive, so it never has to be extracted. the parameters after it apply to all of them
+ * @param path the path from the @ line, relative to the settings file params_->params_file
+ * @param archive_path_length the length of the part of path naming the archive, from isTarInput
+*/
+void newInputsFromArchive(const char* path, size_t archive_path_length)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_NONNULL;
 bool parseParameterLine(const char* arg, bool from_params_file)
     ATTR_NONNULL;
 
 void registerCPath(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file)
     ATTR_NONNULL;
+void registerOutputList(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file)
+    ATTR_NONNULL;
+void registerDepfile(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file)
+    ATTR_NONNULL;
+void registerExternalData(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file)
+    ATTR_NONNULL;
+void registerCacheDir(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file)
+    ATTR_NONNULL;
+void registerShards(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
 void registerHName(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED)
     ATTR_NONNULL;
 void registerExtraHeader(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED)
@@ -69,6 +144,20 @@ void registerAttributes(const char* str, InputFileParams* params, bool from_para
     ATTR_NONNULL;
 void registerLineLength(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED)
     ATTR_NONNULL;
+void registerSplitSize(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
+void registerChecksum(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
+void registerTransform(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
+void registerSection(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
+void registerAlignment(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
+void registerPadTo(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
+void registerGcSections(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
 void registerBase(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED)
     ATTR_NONNULL;
 void registerAligned(const char* str, InputFileParams* params, bool from_params_file ATTR_UNUSED)
@@ -77,6 +166,18 @@ void registerMakeConst(const char* str, InputFileParams* params, bool from_param
     ATTR_NONNULL;
 void registerConstexpr(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED)
     ATTR_NONNULL;
+void registerCppConstexpr(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
+void registerModuleName(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
+void registerReproducible(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
+void registerPathPrefixMap(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
+void registerExternLength(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
+void registerHeaderPerInput(const char* str, InputFileParams* params ATTR_UNUSED, bool from_params_file ATTR_UNUSED)
+    ATTR_NONNULL;
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,298 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "arrgen.h"
+#include "stats.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+#   include <sys/resource.h>
+#endif
+#include "errors.h"
+#include "c_string_stuff.h"
+#include "timing.h"
+#include "transform.h"
+
+// everything about one input, copied out of the parameters since they're freed before the stats are written
+typedef struct {
+    char *path;
+    const char *method;
+    uint64_t input_bytes;
+    uint64_t embedded_bytes;
+    long output_bytes; // -1 if unknown
+    size_t num_chunks;
+    uint64_t num_lookups;
+    uint64_t formatted_bytes; // can be more than embedded_bytes, with padding
+    double seconds[STATS_NUM_PHASES];
+    double start_seconds;
+    uint32_t line_length;
+    uint8_t base;
+    uint8_t transform;
+    bool aligned;
+} InputStats;
+
+static const char* const phase_names_[STATS_NUM_PHASES] = {"parse", "read", "format", "write"};
+
+bool stats_enabled_ = false;
+static bool json_ = false;
+static const char *path_ = NULL;
+static double start_time_;
+// the totals and finished inputs from every thread
+static double phase_seconds_[STATS_NUM_PHASES];
+static InputStats *inputs_ = NULL;
+static size_t num_inputs_ = 0U;
+// the input being written on this thread, if in_input_
+static ARRGEN_THREAD_LOCAL InputStats current_;
+static ARRGEN_THREAD_LOCAL bool in_input_ = false;
+
+static void writeStatsText(FILE* out, double wall_seconds)
+    ATTR_NONNULL;
+
+static void writeStatsJson(FILE* out, double wall_seconds)
+    ATTR_NONNULL;
+
+static void writeProcessStats(FILE* out)
+    ATTR_NONNULL;
+
+void enableStats(bool json, const char* path) {
+    stats_enabled_ = true;
+    json_ = json;
+    path_ = path;
+    start_time_ = monotonicSeconds();
+}
+
+double statsNow(void) {
+    return (stats_enabled_ ? monotonicSeconds() : 0.0);
+}
+
+void statsAddTime(StatsPhase phase, double start) {
+    if (!stats_enabled_)
+        return;
+    const double elapsed = monotonicSeconds()-start;
+    if (in_input_)
+        current_.seconds[phase] += elapsed;
+    lockTiming();
+    phase_seconds_[phase] += elapsed;
+    unlockTiming();
+}
+
+void statsStartInput(const InputFileParams* input) {
+    if (!stats_enabled_)
+        return;
+    current_ = (InputStats) {
+        .path = duplicateString(input->path_original),
+        .method = "none",
+        .output_bytes = -1,
+        .start_seconds = monotonicSeconds(),
+        .line_length = input->line_length,
+        .base = input->base,
+        .transform = input->transform,
+        .aligned = input->aligned,
+    };
+    in_input_ = true;
+}
+
+void statsSetSource(const char* method, uint64_t num_bytes) {
+    if (!in_input_)
+        return;
+    current_.method = method;
+    current_.input_bytes = num_bytes;
+}
+
+void statsCountLookups(size_t num_lookups, size_t num_bytes) {
+    if (!in_input_)
+        return;
+    current_.num_lookups += num_lookups;
+    current_.formatted_bytes += num_bytes;
+}
+
+void statsFinishInput(uint64_t num_embedded_bytes, size_t num_chunks, long num_output_bytes) {
+    if (!in_input_)
+        return;
+    in_input_ = false;
+    current_.embedded_bytes = num_embedded_bytes;
+    current_.num_chunks = num_chunks;
+    current_.output_bytes = num_output_bytes;
+    // reading isn't timed on its own (with mmap it happens in page faults during the formatting), so it's whatever the rest doesn't account for
+    double read_seconds = monotonicSeconds()-current_.start_seconds-current_.seconds[STATS_FORMAT]-current_.seconds[STATS_WRITE];
+    if (read_seconds<0.0)
+        read_seconds = 0.0;
+    current_.seconds[STATS_READ] += read_seconds;
+    lockTiming();
+    phase_seconds_[STATS_READ] += read_seconds;
+    InputStats *inputs = realloc(inputs_, sizeof(InputStats)*(num_inputs_+1U));
+    if (UNLIKELY(inputs==NULL))
+        myFatalErrno("failed to allocate %zu bytes", sizeof(InputStats)*(num_inputs_+1U));
+    inputs_ = inputs;
+    inputs_[num_inputs_++] = current_;
+    unlockTiming();
+}
+
+void writeStats(void) {
+    if (!stats_enabled_)
+        return;
+    const double wall_seconds = monotonicSeconds()-start_time_;
+    FILE *out = (path_==NULL ? stderr : fopen(path_, "w"));
+    if (UNLIKELY(out==NULL)) {
+        myErrorErrno("%s: could not open to write stats", path_);
+        return;
+    }
+    lockTiming();
+    if (json_)
+        writeStatsJson(out, wall_seconds);
+    else
+        writeStatsText(out, wall_seconds);
+    for (size_t i=0U; i<num_inputs_; i++)
+        free(inputs_[i].path);
+    free(inputs_);
+    inputs_ = NULL;
+    num_inputs_ = 0U;
+    unlockTiming();
+    if (out!=stderr && UNLIKELY(fclose(out)!=0))
+        myErrorErrno("%s: could not write stats", path_);
+}
+
+static void writeStatsText(FILE* out, double wall_seconds) {
+    uint64_t total_input_bytes = 0U, total_output_bytes = 0U;
+    fprintf(out,
+        "arrgen stats: %zu inputs in %.3f s\n"
+        "%-40s %-7s %12s %12s %12s %4s %7s %5s %9s %6s %9s %9s %9s %9s %8s\n",
+        num_inputs_,
+        wall_seconds,
+        "input", "method", "read_bytes", "embedded", "output_bytes", "base", "aligned", "line", "transform", "chunks",
+        "read_s", "format_s", "write_s", "MB/s", "repeats");
+    for (size_t i=0U; i<num_inputs_; i++) {
+        const InputStats *input = &inputs_[i];
+        const double seconds = input->seconds[STATS_READ]+input->seconds[STATS_FORMAT];
+        total_input_bytes += input->input_bytes;
+        if (input->output_bytes>0)
+            total_output_bytes += (uint64_t)input->output_bytes;
+        fprintf(out,
+            "%-40s %-7s %12" PRIu64 " %12" PRIu64 " %12ld %4u %7s %5" PRIu32 " %9s %6zu %9.4f %9.4f %9.4f %9.1f %7.1f%%\n",
+            input->path,
+            input->method,
+            input->input_bytes,
+            input->embedded_bytes,
+            input->output_bytes,
+            (unsigned)input->base,
+            (input->aligned ? "yes" : "no"),
+            input->line_length,
+            transformName(input->transform),
+            input->num_chunks,
+            input->seconds[STATS_READ],
+            input->seconds[STATS_FORMAT],
+            input->seconds[STATS_WRITE],
+            (seconds>0.0 ? (double)input->input_bytes/seconds/1e6 : 0.0),
+            (input->formatted_bytes>0U ? 100.0*(double)(input->formatted_bytes-input->num_lookups)/(double)input->formatted_bytes : 0.0));
+    }
+    fprintf(out, "phases:");
+    for (unsigned phase=0U; phase<STATS_NUM_PHASES; phase++)
+        fprintf(out, " %s %.4f s%s", phase_names_[phase], phase_seconds_[phase], (phase+1U<STATS_NUM_PHASES ? "," : "\n"));
+    fprintf(out,
+        "total: %" PRIu64 " bytes read, %" PRIu64 " bytes written for the arrays\n",
+        total_input_bytes,
+        total_output_bytes);
+    writeProcessStats(out);
+}
+
+static void writeStatsJson(FILE* out, double wall_seconds) {
+    fprintf(out, "{\"wall_seconds\":%.6f,\"phases\":{", wall_seconds);
+    for (unsigned phase=0U; phase<STATS_NUM_PHASES; phase++)
+        fprintf(out, "\"%s\":%.6f%s", phase_names_[phase], phase_seconds_[phase], (phase+1U<STATS_NUM_PHASES ? "," : ""));
+    fprintf(out, "},\"inputs\":[");
+    for (size_t i=0U; i<num_inputs_; i++) {
+        const InputStats *input = &inputs_[i];
+        const double seconds = input->seconds[STATS_READ]+input->seconds[STATS_FORMAT];
+        fprintf(out, "%s{\"path\":", (i>0U ? "," : ""));
+        writeJsonString(out, input->path);
+        fprintf(out,
+            ",\"method\":\"%s\",\"input_bytes\":%" PRIu64 ",\"embedded_bytes\":%" PRIu64 ",",
+            input->method,
+            input->input_bytes,
+            input->embedded_bytes);
+        if (input->output_bytes<0)
+            fprintf(out, "\"output_bytes\":null,");
+        else
+            fprintf(out, "\"output_bytes\":%ld,", input->output_bytes);
+        fprintf(out,
+            "\"base\":%u,\"aligned\":%s,\"line_length\":%" PRIu32 ",\"transform\":\"%s\",\"chunks\":%zu,"
+            "\"read_seconds\":%.6f,\"format_seconds\":%.6f,\"write_seconds\":%.6f,\"mb_per_second\":%.3f,"
+            "\"lookups\":%" PRIu64 ",\"repeat_hit_rate\":%.4f}",
+            (unsigned)input->base,
+            (input->aligned ? "true" : "false"),
+            input->line_length,
+            transformName(input->transform),
+            input->num_chunks,
+            input->seconds[STATS_READ],
+            input->seconds[STATS_FORMAT],
+            input->seconds[STATS_WRITE],
+            (seconds>0.0 ? (double)input->input_bytes/seconds/1e6 : 0.0),
+            input->num_lookups,
+            (input->formatted_bytes>0U ? (double)(input->formatted_bytes-input->num_lookups)/(double)input->formatted_bytes : 0.0));
+    }
+    fprintf(out, "],\"process\":");
+    writeProcessStats(out);
+    fprintf(out, "}\n");
+}
+
+// the same numbers in either format, as a line of text or a JSON object
+static void writeProcessStats(FILE* out) {
+    long long max_rss_kib = -1, minor_faults = -1, major_faults = -1, voluntary_switches = -1, involuntary_switches = -1;
+    long long read_syscalls = -1, write_syscalls = -1;
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+    struct rusage usage;
+    if (LIKELY(getrusage(RUSAGE_SELF, &usage)==0)) {
+#   ifdef __APPLE__
+        max_rss_kib = usage.ru_maxrss/1024; // bytes there, KiB everywhere else
+#   else
+        max_rss_kib = usage.ru_maxrss;
+#   endif
+        minor_faults = usage.ru_minflt;
+        major_faults = usage.ru_majflt;
+        voluntary_switches = usage.ru_nvcsw;
+        involuntary_switches = usage.ru_nivcsw;
+    }
+#endif
+#ifdef __linux__
+    // counts every read and write system call the process made, on every thread
+    FILE *io = fopen("/proc/self/io", "r");
+    if (io!=NULL) {
+        char line[64];
+        while (fgets(line, sizeof(line), io)!=NULL) {
+            if (!strncmp(line, "syscr: ", strlen("syscr: ")))
+                read_syscalls = strtoll(&line[strlen("syscr: ")], NULL, 10);
+            else if (!strncmp(line, "syscw: ", strlen("syscw: ")))
+                write_syscalls = strtoll(&line[strlen("syscw: ")], NULL, 10);
+        }
+        fclose(io);
+    }
+#endif
+    if (json_)
+        fprintf(out,
+            "{\"max_rss_kib\":%lld,\"minor_page_faults\":%lld,\"major_page_faults\":%lld,\"read_syscalls\":%lld,"
+            "\"write_syscalls\":%lld,\"voluntary_context_switches\":%lld,\"involuntary_context_switches\":%lld}",
+            max_rss_kib, minor_faults, major_faults, read_syscalls, write_syscalls, voluntary_switches, involuntary_switches);
+    else
+        fprintf(out,
+            "process: peak RSS %lld KiB, %lld minor and %lld major page faults, %lld read and %lld write system calls, "
+            "%lld voluntary and %lld involuntary context switches (-1 where unknown)\n",
+            max_rss_kib, minor_faults, major_faults, read_syscalls, write_syscalls, voluntary_switches, involuntary_switches);
+}
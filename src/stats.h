@@ -0,0 +1,98 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED
+#include "arrgen.h"
+#include "handlefile.h"
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// where the time goes, for --stats
+typedef enum {
+    STATS_PARSE, // reading settings files
+    STATS_READ, // opening, mapping and reading inputs
+    STATS_FORMAT, // turning the bytes into text, which includes page faults on mapped inputs and stdio writing out full buffers
+    STATS_WRITE, // finishing output files: the last flush, comparing with the old file and renaming
+    STATS_NUM_PHASES,
+} StatsPhase;
+
+// set by enableStats. everything else here does nothing when it's false, so the checks at the call sites are only to skip the work of getting the numbers
+extern bool stats_enabled_;
+
+/**
+ * @brief starts collecting stats, to be written by writeStats
+ * @param json write them as JSON rather than as a table
+ * @param path where to write them, or NULL for stderr
+*/
+void enableStats(bool json, const char* path)
+    ATTR_ACCESS(read_only, 2);
+
+/**
+ * @brief the time to pass to statsAddTime later
+*/
+double statsNow(void);
+
+/**
+ * @brief adds the time since start to a phase, and to the input being written on this thread if there is one
+ * @param start from statsNow
+*/
+void statsAddTime(StatsPhase phase, double start);
+
+/**
+ * @brief starts keeping the stats for an input, on this thread
+*/
+void statsStartInput(const InputFileParams* input)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_NONNULL;
+
+/**
+ * @brief records how the input being written on this thread was read
+ * @param method mmap, stream or archive. must be a string literal
+ * @param num_bytes the number of bytes read from it, before any transform
+*/
+void statsSetSource(const char* method, uint64_t num_bytes)
+    ATTR_NONNULL;
+
+/**
+ * @brief counts the lookups writeArrayContents did, to tell how often it could print a run of repeated bytes with one
+ * @param num_lookups the number of times it looked up a byte's text
+ * @param num_bytes the number of bytes it formatted
+*/
+void statsCountLookups(size_t num_lookups, size_t num_bytes);
+
+/**
+ * @brief finishes the input started by statsStartInput
+ * @param num_embedded_bytes the length of the array, after any transform
+ * @param num_chunks the number of chunk arrays it was split into, or 0
+ * @param num_output_bytes how much was written for it, or -1 if that isn't known (eg writing to a pipe)
+*/
+void statsFinishInput(uint64_t num_embedded_bytes, size_t num_chunks, long num_output_bytes);
+
+/**
+ * @brief writes everything collected, along with the process's peak memory use, page faults and system calls.
+ * failure to write is only an error message
+*/
+void writeStats(void);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // STATS_H_INCLUDED
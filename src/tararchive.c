@@ -0,0 +1,271 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arrgen.h"
+#include "tararchive.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "errors.h"
+#include "c_string_stuff.h"
+
+#define TAR_BLOCK_SIZE 512U
+
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+#   define seekForward(file, offset) fseeko((file), (off_t)(offset), SEEK_CUR)
+#elif defined(_WIN32) || defined(_WIN64)
+#   define seekForward(file, offset) _fseeki64((file), (__int64)(offset), SEEK_CUR)
+#else
+#   define seekForward(file, offset) fseek((file), (long)(offset), SEEK_CUR)
+#endif
+
+static bool parseTarNumber(const uint8_t* field, size_t field_length, uint64_t* value)
+    ATTR_ACCESS(read_only, 1, 2)
+    ATTR_ACCESS(write_only, 3)
+    ATTR_NONNULL;
+
+static bool checksumMatches(const uint8_t header[TAR_BLOCK_SIZE])
+    ATTR_ACCESS(read_only, 1)
+    ATTR_PURE
+    ATTR_NONNULL;
+
+static char* readLongData(FILE* in, const char* path, uint64_t length)
+    ATTR_MALLOC(free)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL;
+
+static const char* paxValue(const char* records, size_t length, const char* key, size_t* value_length)
+    ATTR_ACCESS(read_only, 1, 2)
+    ATTR_ACCESS(read_only, 3)
+    ATTR_ACCESS(write_only, 4)
+    ATTR_NONNULL;
+
+static bool parsePaxNumber(const char* value, size_t value_length, uint64_t* number)
+    ATTR_ACCESS(read_only, 1, 2)
+    ATTR_ACCESS(write_only, 3)
+    ATTR_NONNULL;
+
+bool isTarInput(const char* path, size_t* archive_path_length) {
+    // a path that just ends in .tar is the archive itself, embedded like any other file
+    const char *member = strstr(path, ".tar:");
+    if (member!=NULL && member!=path && member[5]!='\0') {
+        *archive_path_length = (size_t)(member-path)+4U;
+        return true;
+    }
+    return false;
+}
+
+TarMember* readTarIndex(const char* path, size_t* num_members) {
+    FILE *in = fopen(path, "rb");
+    if (UNLIKELY(in==NULL))
+        myFatalErrno("%s: could not open", path);
+    TarMember *members = NULL;
+    size_t capacity = 0U;
+    *num_members = 0U;
+    uint64_t offset = 0U;
+    // set by the pax and GNU headers that come before the header they apply to
+    char *next_name = NULL;
+    uint64_t next_length = 0U;
+    bool next_length_given = false;
+    uint8_t header[TAR_BLOCK_SIZE];
+    for (;;) {
+        size_t num_read = fread(header, 1, TAR_BLOCK_SIZE, in);
+        if (UNLIKELY(num_read!=TAR_BLOCK_SIZE)) {
+            if (ferror(in))
+                myFatalErrno("%s: read", path);
+            if (UNLIKELY(num_read!=0U))
+                myFatal("%s: not a tar archive, or cut off at offset %" PRIu64, path, offset);
+            // the end-of-archive blocks are missing, but everything before was fine
+            break;
+        }
+        offset += TAR_BLOCK_SIZE;
+        if (header[0]=='\0') // the end-of-archive marker is a zero block, no point checking for the second one
+            break;
+        uint64_t length;
+        if (UNLIKELY(!checksumMatches(header) || !parseTarNumber(&header[124], 12U, &length)))
+            myFatal("%s: not a tar archive, or corrupt at offset %" PRIu64 " (compressed archives aren't supported)", path, offset-TAR_BLOCK_SIZE);
+        const char type = (char)header[156];
+        // a pax size is for the member itself, not for any other extended header in between
+        if (next_length_given && type!='x' && type!='g' && type!='L' && type!='K')
+            length = next_length;
+        const uint64_t padded_length = (length+TAR_BLOCK_SIZE-1U)/TAR_BLOCK_SIZE*TAR_BLOCK_SIZE;
+        switch (type) {
+        case 'x': { // pax extended header, for the next member
+            char *records = readLongData(in, path, length);
+            size_t value_length;
+            const char *value = paxValue(records, (size_t)length, "path", &value_length);
+            if (value!=NULL && value_length>0U) {
+                free(next_name);
+                next_name = duplicateStringLen(value, value_length);
+            }
+            value = paxValue(records, (size_t)length, "size", &value_length);
+            if (value!=NULL) {
+                if (UNLIKELY(!parsePaxNumber(value, value_length, &next_length)))
+                    myFatal("%s: corrupt size in the extended header at offset %" PRIu64, path, offset-TAR_BLOCK_SIZE);
+                next_length_given = true;
+            }
+            free(records);
+            offset += padded_length;
+            if (UNLIKELY(seekForward(in, padded_length-length)!=0))
+                myFatalErrno("%s: seek", path);
+            continue;
+            }
+        case 'L': // GNU long name, for the next member
+            free(next_name);
+            next_name = readLongData(in, path, length);
+            offset += padded_length;
+            if (UNLIKELY(seekForward(in, padded_length-length)!=0))
+                myFatalErrno("%s: seek", path);
+            continue;
+        case 'K': // GNU long link name, which only links have any use for
+            offset += padded_length;
+            if (UNLIKELY(seekForward(in, padded_length)!=0))
+                myFatalErrno("%s: seek", path);
+            continue;
+        case '0':
+        case '\0':
+        case '7': { // regular files
+            char *name = next_name;
+            if (name==NULL) {
+                // ustar splits long names into a prefix and the rest
+                const bool is_ustar = !memcmp(&header[257], "ustar", 5U);
+                const size_t prefix_length = (is_ustar ? strnlen((const char*)&header[345], 155U) : 0U);
+                const size_t name_length = strnlen((const char*)header, 100U);
+                name = sprintfAppend(NULL, "%.*s%s%.*s",
+                    (int)prefix_length, (const char*)&header[345],
+                    (prefix_length>0U ? "/" : ""),
+                    (int)name_length, (const char*)header);
+            }
+            next_name = NULL;
+            const char *trimmed = name;
+            while (trimmed[0]=='.' && trimmed[1]=='/')
+                trimmed += 2;
+            if (*num_members==capacity) {
+                capacity = (capacity==0U ? 16U : capacity*2U);
+                members = realloc(members, sizeof(TarMember)*capacity);
+                if (UNLIKELY(members==NULL))
+                    myFatalErrno("failed to allocate %zu bytes", sizeof(TarMember)*capacity);
+            }
+            members[(*num_members)++] = (TarMember) {
+                .name = (trimmed==name ? name : duplicateString(trimmed)),
+                .offset = offset,
+                .length = length,
+            };
+            if (trimmed!=name)
+                free(name);
+            } break;
+        default: // directories, links, devices, global pax headers, and anything else that isn't a file to embed
+            free(next_name);
+            next_name = NULL;
+            break;
+        }
+        next_length_given = false;
+        offset += padded_length;
+        if (UNLIKELY(seekForward(in, padded_length)!=0))
+            myFatalErrno("%s: seek", path);
+    }
+    free(next_name);
+    fclose(in);
+    DLOG("%s: %zu members", path, *num_members);
+    return members;
+}
+
+void freeTarIndex(TarMember* members, size_t num_members) {
+    for (size_t i=0U; i<num_members; i++)
+        free(members[i].name);
+    free(members);
+}
+
+// octal with spaces or nulls around it, or for big numbers, base-256 with the high bit of the first byte set (a GNU extension)
+static bool parseTarNumber(const uint8_t* field, size_t field_length, uint64_t* value) {
+    *value = 0U;
+    if (field[0] & 0x80U) {
+        for (size_t i=1U; i<field_length; i++) {
+            if (*value>>56)
+                return false;
+            *value = (*value<<8) | field[i];
+        }
+        return true;
+    }
+    size_t i = 0U;
+    while (i<field_length && field[i]==' ')
+        i++;
+    for (; i<field_length && field[i]>='0' && field[i]<='7'; i++)
+        *value = (*value<<3) | (uint64_t)(field[i]-'0');
+    return i==field_length || field[i]==' ' || field[i]=='\0';
+}
+
+// the sum of every byte of the header, counting the checksum field itself as spaces
+static bool checksumMatches(const uint8_t header[TAR_BLOCK_SIZE]) {
+    uint64_t expected;
+    if (!parseTarNumber(&header[148], 8U, &expected))
+        return false;
+    uint64_t sum = 8U*' ';
+    for (size_t i=0U; i<TAR_BLOCK_SIZE; i++)
+        if (i<148U || i>=156U)
+            sum += header[i];
+    return sum==expected;
+}
+
+static char* readLongData(FILE* in, const char* path, uint64_t length) {
+    // nothing real needs this much, so it's probably corrupt
+    if (UNLIKELY(length>(1U<<20)))
+        myFatal("%s: extended header of %" PRIu64 " bytes is too long", path, length);
+    char *ret = malloc((size_t)length+1U);
+    if (UNLIKELY(ret==NULL))
+        myFatalErrno("failed to allocate %zu bytes", (size_t)length+1U);
+    if (UNLIKELY(fread(ret, 1, (size_t)length, in)!=(size_t)length))
+        myFatalErrno("%s: archive ends in the middle of an extended header", path);
+    ret[length] = '\0';
+    return ret;
+}
+
+// pax records are "LENGTH KEY=VALUE\n", where LENGTH counts the whole record. values can contain anything, even
+// something that looks like another record, so they have to be stepped over by LENGTH rather than searched
+static const char* paxValue(const char* records, size_t length, const char* key, size_t* value_length) {
+    const size_t key_length = strlen(key);
+    size_t pos = 0U;
+    while (pos<length) {
+        char *end;
+        unsigned long record_length = strtoul(&records[pos], &end, 10);
+        if (record_length==0U || pos+record_length>length || *end!=' ')
+            return NULL;
+        const char *record_key = end+1;
+        const char *record_end = &records[pos+record_length-1U]; // the newline
+        if ((size_t)(record_end-record_key)>key_length && !memcmp(record_key, key, key_length) && record_key[key_length]=='=') {
+            *value_length = (size_t)(record_end-record_key)-key_length-1U;
+            return record_key+key_length+1U;
+        }
+        pos += record_length;
+    }
+    return NULL;
+}
+
+// decimal, and nothing else
+static bool parsePaxNumber(const char* value, size_t value_length, uint64_t* number) {
+    *number = 0U;
+    if (value_length==0U)
+        return false;
+    for (size_t i=0U; i<value_length; i++) {
+        if (value[i]<'0' || value[i]>'9' || *number>(UINT64_MAX-9U)/10U)
+            return false;
+        *number = *number*10U + (uint64_t)(value[i]-'0');
+    }
+    return true;
+}
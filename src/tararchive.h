@@ -0,0 +1,60 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TARARCHIVE_H_INCLUDED
+#define TARARCHIVE_H_INCLUDED
+#include "arrgen.h"
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// a regular file in a tar archive
+typedef struct {
+    char *name; // with any leading ./ taken off
+    uint64_t offset; // where its contents start, from the start of the archive
+    uint64_t length;
+} TarMember;
+
+/**
+ * @brief whether an input path from a settings file refers to files in a tar archive: .tar: followed by either the name of
+ * one file in it or * for every file in it. a path only ending in .tar isn't one
+ * @param archive_path_length set to the length of the part of path that's the archive itself
+*/
+bool isTarInput(const char* path, size_t* archive_path_length)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_ACCESS(write_only, 2)
+    ATTR_NONNULL;
+
+/**
+ * @brief reads the headers of an uncompressed tar archive (ustar, pax or GNU), skipping over the contents of each member.
+ * only regular files are listed, in the order they're in the archive. failure is fatal
+ * @param num_members set to the number of regular files found
+ * @return the files found, to be freed with freeTarIndex
+*/
+ATTR_NODISCARD
+TarMember* readTarIndex(const char* path, size_t* num_members)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_ACCESS(write_only, 2)
+    ATTR_NONNULL;
+
+void freeTarIndex(TarMember* members, size_t num_members);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // TARARCHIVE_H_INCLUDED
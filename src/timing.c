@@ -0,0 +1,50 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arrgen.h"
+#include "timing.h"
+#include <time.h>
+#ifdef ARRGEN_THREADS_SUPPORTED
+#   include <pthread.h>
+#endif
+
+#ifdef ARRGEN_THREADS_SUPPORTED
+static pthread_mutex_t mutex_ = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+double monotonicSeconds(void) {
+    struct timespec now;
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    timespec_get(&now, TIME_UTC);
+#endif
+    return (double)now.tv_sec + (double)now.tv_nsec*1e-9;
+}
+
+void lockTiming(void) {
+#ifdef ARRGEN_THREADS_SUPPORTED
+    pthread_mutex_lock(&mutex_);
+#endif
+}
+
+void unlockTiming(void) {
+#ifdef ARRGEN_THREADS_SUPPORTED
+    pthread_mutex_unlock(&mutex_);
+#endif
+}
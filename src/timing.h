@@ -0,0 +1,43 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMING_H_INCLUDED
+#define TIMING_H_INCLUDED
+#include "arrgen.h"
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * @brief seconds since some fixed point, only good for subtracting from each other. monotonic where the platform has
+ * a monotonic clock, otherwise the wall clock
+*/
+double monotonicSeconds(void);
+
+/**
+ * @brief takes the lock that --stats and --trace share for everything the threads write to. does nothing without
+ * threads. must not be held while calling either of them
+*/
+void lockTiming(void);
+
+void unlockTiming(void);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // TIMING_H_INCLUDED
@@ -0,0 +1,107 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arrgen.h"
+#include "trace.h"
+#include <stdio.h>
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+#   include <unistd.h>
+#endif
+#include "errors.h"
+#include "c_string_stuff.h"
+#include "timing.h"
+
+bool trace_enabled_ = false;
+static FILE *trace_file_ = NULL;
+static const char *trace_path_ = NULL;
+static double start_time_;
+static long pid_ = 1L;
+static unsigned num_threads_ = 0U;
+// the number this thread's events are tagged with, or 0 if it hasn't written any yet
+static ARRGEN_THREAD_LOCAL unsigned thread_number_ = 0U;
+
+static void writeThreadName(unsigned thread_number);
+
+bool startTrace(const char* path) {
+    trace_file_ = fopen(path, "w");
+    if (UNLIKELY(trace_file_==NULL)) {
+        myErrorErrno("%s: could not open trace file", path);
+        return false;
+    }
+    trace_path_ = path;
+#if (ARRGEN_MMAP_SUPPORTED == ARRGEN_MMAP_TYPE_POSIX)
+    pid_ = (long)getpid();
+#endif
+    // the array form rather than an object, since the viewers still accept it without the closing ] if arrgen dies partway through
+    fprintf(trace_file_, "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":0,\"args\":{\"name\":\"arrgen\"}}", pid_);
+    thread_number_ = ++num_threads_;
+    writeThreadName(thread_number_);
+    start_time_ = monotonicSeconds();
+    trace_enabled_ = true;
+    return true;
+}
+
+double traceNow(void) {
+    return (trace_enabled_ ? monotonicSeconds() : 0.0);
+}
+
+void traceSpan(const char* name, const char* path, double start) {
+    if (!trace_enabled_)
+        return;
+    const double end = monotonicSeconds();
+    lockTiming();
+    if (thread_number_==0U) {
+        thread_number_ = ++num_threads_;
+        writeThreadName(thread_number_);
+    }
+    // complete events, in microseconds since the start
+    fprintf(trace_file_, ",\n{\"name\":\"%s\",\"cat\":\"arrgen\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%u",
+        name,
+        (start-start_time_)*1e6,
+        (end-start)*1e6,
+        pid_,
+        thread_number_);
+    if (path!=NULL) {
+        fprintf(trace_file_, ",\"args\":{\"path\":");
+        writeJsonString(trace_file_, path);
+        putc('}', trace_file_);
+    }
+    putc('}', trace_file_);
+    unlockTiming();
+}
+
+void finishTrace(void) {
+    if (!trace_enabled_)
+        return;
+    trace_enabled_ = false;
+    fprintf(trace_file_, "\n]\n");
+    if (UNLIKELY(ferror(trace_file_)))
+        myErrorErrno("%s: could not write trace", trace_path_);
+    if (UNLIKELY(fclose(trace_file_)!=0))
+        myErrorErrno("%s: could not close trace file", trace_path_);
+    trace_file_ = NULL;
+}
+
+// the first thread is the one that called startTrace, the rest are only ever the workers for -j
+static void writeThreadName(unsigned thread_number) {
+    fprintf(trace_file_, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%u,\"args\":{\"name\":\"", pid_, thread_number);
+    if (thread_number==1U)
+        fprintf(trace_file_, "main\"}}");
+    else
+        fprintf(trace_file_, "worker %u\"}}", thread_number-1U);
+}
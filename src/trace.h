@@ -0,0 +1,59 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+#include "arrgen.h"
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// set by startTrace. everything else here does nothing when it's false
+extern bool trace_enabled_;
+
+/**
+ * @brief starts writing a trace in the Chrome trace event format (which Perfetto and chrome://tracing both read) to path.
+ * must be called on the main thread, before any others are started. prints an error message on failure
+*/
+bool startTrace(const char* path)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_NONNULL;
+
+/**
+ * @brief the time to pass to traceSpan later
+*/
+double traceNow(void);
+
+/**
+ * @brief records that this thread spent the time since start doing something
+ * @param name what it was doing. must be a string literal
+ * @param path the file it was doing it to, or NULL
+ * @param start from traceNow
+*/
+void traceSpan(const char* name, const char* path, double start)
+    ATTR_NONNULL_N(1);
+
+/**
+ * @brief finishes the trace file. failure is only an error message
+*/
+void finishTrace(void);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // TRACE_H_INCLUDED
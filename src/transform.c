@@ -0,0 +1,238 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "arrgen.h"
+#include "transform.h"
+#include <string.h>
+#include "errors.h"
+
+// where json and clike mode are in the input
+enum {
+    TRANSFORM_CODE = 0,
+    TRANSFORM_SLASH, // a / that might be the start of a comment
+    TRANSFORM_LINE_COMMENT,
+    TRANSFORM_BLOCK_COMMENT,
+    TRANSFORM_BLOCK_COMMENT_STAR, // a * that might be the end of the comment
+    TRANSFORM_DOUBLE_QUOTED,
+    TRANSFORM_DOUBLE_QUOTED_ESCAPE,
+    TRANSFORM_SINGLE_QUOTED,
+    TRANSFORM_SINGLE_QUOTED_ESCAPE,
+};
+
+static size_t transformCode(TransformState* state, const uint8_t* in, size_t length, uint8_t* out)
+    ATTR_ACCESS(read_write, 1)
+    ATTR_ACCESS(read_only, 2, 3)
+    ATTR_ACCESS(write_only, 4)
+    ATTR_NONNULL_N(1)
+    ATTR_NONNULL_N(4);
+
+static size_t transformText(TransformState* state, const uint8_t* in, size_t length, uint8_t* out)
+    ATTR_ACCESS(read_write, 1)
+    ATTR_ACCESS(read_only, 2, 3)
+    ATTR_ACCESS(write_only, 4)
+    ATTR_NONNULL_N(1)
+    ATTR_NONNULL_N(4);
+
+static inline size_t writeToken(TransformState* state, uint8_t* out, uint8_t c)
+    ATTR_ACCESS(read_write, 1)
+    ATTR_ACCESS(write_only, 2)
+    ATTR_NONNULL;
+
+static inline void addSpace(TransformState* state, uint8_t space)
+    ATTR_ACCESS(read_write, 1)
+    ATTR_NONNULL;
+
+// in the order of the ARRGEN_TRANSFORM_* values
+static const char* const transform_names_[] = {"none", "eol", "text", "json", "clike"};
+
+uint8_t parseTransform(const char* name) {
+    for (uint8_t i=0U; i<sizeof(transform_names_)/sizeof(transform_names_[0]); i++)
+        if (!strcmp(name, transform_names_[i]))
+            return i;
+    myFatal("invalid transform %s, must be none, eol, text, json or clike", name);
+}
+
+const char* transformName(uint8_t which) {
+    return (which<sizeof(transform_names_)/sizeof(transform_names_[0]) ? transform_names_[which] : "unknown");
+}
+
+void startTransform(TransformState* state, uint8_t which) {
+    state->which = which;
+    state->state = TRANSFORM_CODE;
+    state->pending_space = 0U;
+    state->pending_cr = false;
+    state->any_written = false;
+    state->num_blanks = 0U;
+}
+
+size_t transformBytes(TransformState* state, const uint8_t* in, size_t length, uint8_t* out) {
+    switch (state->which) {
+    case ARRGEN_TRANSFORM_EOL:
+    case ARRGEN_TRANSFORM_TEXT:
+        return transformText(state, in, length, out);
+    case ARRGEN_TRANSFORM_JSON:
+    case ARRGEN_TRANSFORM_CLIKE:
+        return transformCode(state, in, length, out);
+    default:
+        memcpy(out, in, length);
+        return length;
+    }
+}
+
+size_t finishTransform(TransformState* state, uint8_t* out) {
+    size_t num_written = 0U;
+    // trailing whitespace at the end of the input is whitespace at the end of a line too, so any blanks are just dropped
+    if (state->pending_cr)
+        out[num_written++] = '\n';
+    if (state->state==TRANSFORM_SLASH)
+        num_written += writeToken(state, &out[num_written], '/');
+    startTransform(state, state->which);
+    return num_written;
+}
+
+static size_t transformText(TransformState* state, const uint8_t* in, size_t length, uint8_t* out) {
+    size_t num_written = 0U;
+    for (size_t i=0U; i<length; i++) {
+        const uint8_t c = in[i];
+        if (state->pending_cr) {
+            // a lone CR is a line ending too, like old Mac files
+            state->pending_cr = false;
+            state->num_blanks = 0U;
+            out[num_written++] = '\n';
+            if (c=='\n')
+                continue;
+        }
+        if (c=='\r')
+            state->pending_cr = true;
+        else if (c=='\n') {
+            state->num_blanks = 0U;
+            out[num_written++] = '\n';
+        } else if (state->which==ARRGEN_TRANSFORM_TEXT && (c==' ' || c=='\t')) {
+            if (UNLIKELY(state->num_blanks==ARRGEN_TRANSFORM_MAX_BLANKS)) {
+                memcpy(&out[num_written], state->blanks, state->num_blanks);
+                num_written += state->num_blanks;
+                state->num_blanks = 0U;
+            }
+            state->blanks[state->num_blanks++] = c;
+        } else {
+            // the blanks weren't at the end of the line after all
+            memcpy(&out[num_written], state->blanks, state->num_blanks);
+            num_written += state->num_blanks;
+            state->num_blanks = 0U;
+            out[num_written++] = c;
+        }
+    }
+    return num_written;
+}
+
+// comments count as whitespace, like they do to a C compiler. whitespace with a line break in it stays a line break,
+// since preprocessor directives end at one
+static size_t transformCode(TransformState* state, const uint8_t* in, size_t length, uint8_t* out) {
+    const bool clike = (state->which==ARRGEN_TRANSFORM_CLIKE);
+    size_t num_written = 0U;
+    for (size_t i=0U; i<length; i++) {
+        const uint8_t c = in[i];
+        switch (state->state) {
+        case TRANSFORM_SLASH:
+            if (c=='/') {
+                state->state = TRANSFORM_LINE_COMMENT;
+                continue;
+            }
+            if (c=='*') {
+                addSpace(state, ' ');
+                state->state = TRANSFORM_BLOCK_COMMENT;
+                continue;
+            }
+            num_written += writeToken(state, &out[num_written], '/');
+            state->state = TRANSFORM_CODE;
+            // fall through - c is handled like any other code
+        case TRANSFORM_CODE:
+            switch (c) {
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\f':
+            case '\v':
+                addSpace(state, ' ');
+                break;
+            case '\n':
+                addSpace(state, '\n');
+                break;
+            case '/':
+                state->state = TRANSFORM_SLASH;
+                break;
+            case '"':
+                num_written += writeToken(state, &out[num_written], c);
+                state->state = TRANSFORM_DOUBLE_QUOTED;
+                break;
+            case '\'':
+                num_written += writeToken(state, &out[num_written], c);
+                if (clike)
+                    state->state = TRANSFORM_SINGLE_QUOTED;
+                break;
+            default:
+                num_written += writeToken(state, &out[num_written], c);
+            }
+            break;
+        case TRANSFORM_LINE_COMMENT:
+            if (c=='\n') {
+                addSpace(state, '\n');
+                state->state = TRANSFORM_CODE;
+            }
+            break;
+        case TRANSFORM_BLOCK_COMMENT:
+        case TRANSFORM_BLOCK_COMMENT_STAR:
+            if (c=='/' && state->state==TRANSFORM_BLOCK_COMMENT_STAR)
+                state->state = TRANSFORM_CODE;
+            else {
+                if (c=='\n')
+                    addSpace(state, '\n');
+                state->state = (c=='*' ? TRANSFORM_BLOCK_COMMENT_STAR : TRANSFORM_BLOCK_COMMENT);
+            }
+            break;
+        default:
+            // in a string or character literal, which is copied exactly. neither can go past the end of a line
+            // without a backslash, so a stray quote can't swallow the rest of the input
+            out[num_written++] = c;
+            if (state->state==TRANSFORM_DOUBLE_QUOTED_ESCAPE || state->state==TRANSFORM_SINGLE_QUOTED_ESCAPE)
+                state->state--;
+            else if (c=='\\')
+                state->state++;
+            else if (c=='\n' || c==(state->state==TRANSFORM_DOUBLE_QUOTED ? '"' : '\''))
+                state->state = TRANSFORM_CODE;
+        }
+    }
+    return num_written;
+}
+
+static inline size_t writeToken(TransformState* state, uint8_t* out, uint8_t c) {
+    size_t num_written = 0U;
+    // json never needs whitespace between tokens. clike does, eg between a type and a name
+    if (state->which==ARRGEN_TRANSFORM_CLIKE && state->pending_space!=0U && state->any_written)
+        out[num_written++] = state->pending_space;
+    state->pending_space = 0U;
+    state->any_written = true;
+    out[num_written++] = c;
+    return num_written;
+}
+
+static inline void addSpace(TransformState* state, uint8_t space) {
+    if (state->pending_space!='\n')
+        state->pending_space = space;
+}
@@ -0,0 +1,97 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRANSFORM_H_INCLUDED
+#define TRANSFORM_H_INCLUDED
+#include "arrgen.h"
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// what to do to an input's bytes before they're embedded
+#define ARRGEN_TRANSFORM_NONE 0U
+#define ARRGEN_TRANSFORM_EOL 1U // CRLF and lone CR line endings to LF
+#define ARRGEN_TRANSFORM_TEXT 2U // EOL, and whitespace at the ends of lines taken off
+#define ARRGEN_TRANSFORM_JSON 3U // whitespace and // or /* */ comments outside strings taken out
+#define ARRGEN_TRANSFORM_CLIKE 4U // comments taken out and whitespace squashed, keeping line breaks so preprocessor lines still work. for GLSL and C
+
+// the most trailing whitespace remembered at once in text mode. a longer run at the end of a line is kept rather than stripped
+#define ARRGEN_TRANSFORM_MAX_BLANKS 64U
+// how much more room than the input length the output of transformBytes and finishTransform needs, for what was held back from earlier calls
+#define ARRGEN_TRANSFORM_SLACK (ARRGEN_TRANSFORM_MAX_BLANKS+8U)
+
+// what a transform has seen so far. some bytes are held back until it's known whether they're kept
+typedef struct {
+    uint8_t which; // ARRGEN_TRANSFORM_*
+    uint8_t state; // where in a string or comment it is, for json and clike
+    uint8_t pending_space; // the whitespace to put before the next token in clike mode: 0, ' ' or '\n'
+    bool pending_cr;
+    bool any_written; // so clike mode doesn't start with whitespace
+    uint8_t num_blanks;
+    uint8_t blanks[ARRGEN_TRANSFORM_MAX_BLANKS];
+} TransformState;
+
+/**
+ * @brief parses the name of a transform, as given to %transform=
+ * @return one of ARRGEN_TRANSFORM_*. an unknown name is fatal
+*/
+uint8_t parseTransform(const char* name)
+    ATTR_ACCESS(read_only, 1)
+    ATTR_NONNULL;
+
+/**
+ * @brief the name parseTransform takes for a transform
+*/
+const char* transformName(uint8_t which)
+    ATTR_CONST
+    ATTR_RETURNS_NONNULL;
+
+void startTransform(TransformState* state, uint8_t which)
+    ATTR_ACCESS(write_only, 1)
+    ATTR_NONNULL;
+
+/**
+ * @brief transforms the next piece of an input. what it writes never adds up to more than what it's been given
+ * @param in the next bytes of the input
+ * @param length number of bytes in in
+ * @param out where to put the transformed bytes, with room for length+ARRGEN_TRANSFORM_SLACK bytes. can't overlap in
+ * @return the number of bytes written to out
+*/
+size_t transformBytes(TransformState* state, const uint8_t* in, size_t length, uint8_t* out)
+    ATTR_ACCESS(read_write, 1)
+    ATTR_ACCESS(read_only, 2, 3)
+    ATTR_ACCESS(write_only, 4)
+    ATTR_HOT
+    ATTR_NONNULL_N(1)
+    ATTR_NONNULL_N(4);
+
+/**
+ * @brief writes whatever was still being held back at the end of the input
+ * @param out with room for ARRGEN_TRANSFORM_SLACK bytes
+ * @return the number of bytes written to out
+*/
+size_t finishTransform(TransformState* state, uint8_t* out)
+    ATTR_ACCESS(read_write, 1)
+    ATTR_ACCESS(write_only, 2)
+    ATTR_NONNULL;
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // TRANSFORM_H_INCLUDED
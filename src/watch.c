@@ -0,0 +1,138 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arrgen.h"
+#include "watch.h"
+#ifdef ARRGEN_WATCH_SUPPORTED
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "errors.h"
+#include "c_string_stuff.h"
+
+#ifndef ARRGEN_WATCH_DEBOUNCE_MS
+#   define ARRGEN_WATCH_DEBOUNCE_MS 100
+#endif // ARRGEN_WATCH_DEBOUNCE_MS
+
+#define ARRGEN_WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB)
+
+struct Watcher {
+    int fd;
+    size_t num_paths;
+    int *wds; // the watch descriptor of the directory containing each path
+    const char **names; // the base name of each path, which is what inotify gives for events in a directory
+};
+
+static bool markChanged(const Watcher* watcher, const struct inotify_event* event, bool changed[])
+    ATTR_ACCESS(read_only, 1)
+    ATTR_ACCESS(read_only, 2)
+    ATTR_NONNULL;
+
+Watcher* startWatching(const char* const paths[], size_t num_paths) {
+    Watcher *watcher = malloc(sizeof(Watcher));
+    if (UNLIKELY(watcher==NULL))
+        myFatalErrno("failed to allocate %zu bytes", sizeof(Watcher));
+    watcher->fd = inotify_init1(IN_CLOEXEC);
+    if (UNLIKELY(watcher->fd<0))
+        myFatalErrno("inotify_init1");
+    watcher->num_paths = num_paths;
+    watcher->wds = malloc(sizeof(int)*num_paths);
+    watcher->names = malloc(sizeof(char*)*num_paths);
+    if (UNLIKELY(watcher->wds==NULL || watcher->names==NULL))
+        myFatalErrno("failed to allocate memory to watch %zu files", num_paths);
+    for (size_t i=0U; i<num_paths; i++) {
+        const char *last_slash = strrchr(paths[i], '/');
+        char *dir = (last_slash==NULL ? duplicateString(".") : duplicateStringLen(paths[i], last_slash==paths[i] ? 1 : last_slash-paths[i]));
+        // watching the same directory twice gives back the same descriptor, so there's no need to check for duplicates
+        watcher->wds[i] = inotify_add_watch(watcher->fd, dir, ARRGEN_WATCH_EVENTS);
+        if (UNLIKELY(watcher->wds[i]<0))
+            myFatalErrno("%s: could not watch", dir);
+        watcher->names[i] = (last_slash==NULL ? paths[i] : last_slash+1);
+        DLOG("%s: watching %s for %s (wd %d)", paths[i], dir, watcher->names[i], watcher->wds[i]);
+        free(dir);
+    }
+    return watcher;
+}
+
+bool waitForChanges(Watcher* watcher, bool changed[]) {
+    // inotify events are variable-length, but always aligned like struct inotify_event
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    bool any_changed = false;
+    int timeout = -1; // wait as long as it takes for the first change
+    for (size_t i=0U; i<watcher->num_paths; i++)
+        changed[i] = false;
+    for (;;) {
+        struct pollfd poll_fd = {
+            .fd = watcher->fd,
+            .events = POLLIN,
+        };
+        int res = poll(&poll_fd, 1, timeout);
+        if (UNLIKELY(res<0)) {
+            if (errno==EINTR)
+                continue;
+            myErrorErrno("poll");
+            return false;
+        } else if (res==0) // quiet for long enough
+            return true;
+        ssize_t length = read(watcher->fd, buf, sizeof(buf));
+        if (UNLIKELY(length<0)) {
+            if (errno==EINTR || errno==EAGAIN)
+                continue;
+            myErrorErrno("read inotify events");
+            return false;
+        }
+        for (const char *cur=buf; cur<&buf[length]; ) {
+            const struct inotify_event *event = (const struct inotify_event*)cur;
+            any_changed = markChanged(watcher, event, changed) || any_changed;
+            cur += sizeof(struct inotify_event) + event->len;
+        }
+        if (any_changed)
+            timeout = ARRGEN_WATCH_DEBOUNCE_MS;
+    }
+}
+
+void stopWatching(Watcher* watcher) {
+    close(watcher->fd);
+    free(watcher->wds);
+    free(watcher->names);
+    free(watcher);
+}
+
+static bool markChanged(const Watcher* watcher, const struct inotify_event* event, bool changed[]) {
+    bool ret = false;
+    if (UNLIKELY(event->mask & IN_Q_OVERFLOW)) {
+        // some events were lost, so anything could have changed
+        myError("too many changes at once, regenerating everything");
+        for (size_t i=0U; i<watcher->num_paths; i++)
+            changed[i] = true;
+        return true;
+    }
+    if (event->len==0U)
+        return false;
+    for (size_t i=0U; i<watcher->num_paths; i++)
+        if (watcher->wds[i]==event->wd && !strcmp(watcher->names[i], event->name)) {
+            DLOG("%s changed (mask %x)", event->name, event->mask);
+            changed[i] = true;
+            ret = true;
+        }
+    return ret;
+}
+
+#endif // ARRGEN_WATCH_SUPPORTED
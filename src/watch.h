@@ -0,0 +1,57 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WATCH_H_INCLUDED
+#define WATCH_H_INCLUDED
+#include "arrgen.h"
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+#ifdef ARRGEN_WATCH_SUPPORTED
+
+typedef struct Watcher Watcher;
+
+/**
+ * @brief starts watching paths for changes. the directories containing them are what's actually watched,
+ * so editors that save by writing a new file and renaming it over the old one are noticed too
+ * @param paths the files to watch. must stay valid until stopWatching
+ * @return never NULL, failure is fatal
+*/
+Watcher* startWatching(const char* const paths[], size_t num_paths)
+    ATTR_ACCESS(read_only, 1, 2)
+    ATTR_RETURNS_NONNULL
+    ATTR_NONNULL;
+
+/**
+ * @brief waits until at least one of the paths changes, then until nothing has changed for ARRGEN_WATCH_DEBOUNCE_MS,
+ * so a burst of saves only causes one regeneration. changes made since the last call (or since startWatching) count too
+ * @param changed set to whether each path changed, in the same order they were given to startWatching
+ * @return false if watching failed, after printing an error message
+*/
+bool waitForChanges(Watcher* watcher, bool changed[])
+    ATTR_ACCESS(read_write, 1)
+    ATTR_NONNULL;
+
+void stopWatching(Watcher* watcher)
+    ATTR_NONNULL;
+
+#endif // ARRGEN_WATCH_SUPPORTED
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // WATCH_H_INCLUDED
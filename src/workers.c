@@ -0,0 +1,155 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arrgen.h"
+#include "workers.h"
+#include "errors.h"
+#include "jobserver.h"
+#ifdef ARRGEN_THREADS_SUPPORTED
+#   include <errno.h>
+#   include <pthread.h>
+#   include <stdatomic.h>
+#   include <stdlib.h>
+#endif
+#if defined(__linux__) || defined(__APPLE__) || defined(__CYGWIN__)
+#   include <unistd.h>
+#endif
+
+#ifdef ARRGEN_THREADS_SUPPORTED
+typedef struct {
+    WorkerTask task;
+    void* arg;
+    size_t num_tasks;
+    Jobserver *jobserver;
+    atomic_size_t next_index;
+    atomic_bool all_succeeded;
+} WorkerQueue;
+
+typedef struct {
+    pthread_t thread;
+    WorkerQueue *queue;
+    char token; // the jobserver token this thread gives back when it's done, if there's a jobserver
+} WorkerThread;
+
+static bool startWorker(WorkerThread* worker, WorkerQueue* queue, unsigned number)
+    ATTR_NONNULL;
+
+static bool runNextTask(WorkerQueue* queue)
+    ATTR_NONNULL;
+
+static void* workerMain(void* worker_ptr)
+    ATTR_NONNULL;
+#endif // ARRGEN_THREADS_SUPPORTED
+
+bool runParallel(size_t num_tasks, unsigned num_threads, Jobserver* jobserver, WorkerTask task, void* arg) {
+#ifdef ARRGEN_THREADS_SUPPORTED
+    if (num_threads>num_tasks)
+        num_threads = (unsigned)num_tasks;
+    if (num_threads>1U) {
+        WorkerQueue queue = {
+            .task = task,
+            .arg = arg,
+            .num_tasks = num_tasks,
+            .jobserver = jobserver,
+        };
+        atomic_init(&queue.next_index, 0U);
+        atomic_init(&queue.all_succeeded, true);
+        WorkerThread *workers = malloc(sizeof(WorkerThread)*(num_threads-1U));
+        if (UNLIKELY(workers==NULL))
+            myFatalErrno("failed to allocate %zu bytes", sizeof(WorkerThread)*(num_threads-1U));
+        unsigned num_started = 0U;
+        if (jobserver==NULL) {
+            for (; num_started<num_threads-1U; num_started++)
+                if (UNLIKELY(!startWorker(&workers[num_started], &queue, num_started)))
+                    break;
+            DLOG("started %u worker threads for %zu tasks", num_started, num_tasks);
+            while (runNextTask(&queue));
+        } else {
+            // this thread runs on the job slot make gave arrgen itself. each other thread needs a token first, and whether
+            // there are any free is checked again before every task this thread takes, so tokens freed up later get used too
+            unsigned max_started = num_threads-1U;
+            do {
+                while (num_started<max_started
+                        && atomic_load(&queue.next_index)<num_tasks
+                        && tryAcquireJobToken(jobserver, &workers[num_started].token)) {
+                    if (UNLIKELY(!startWorker(&workers[num_started], &queue, num_started))) {
+                        releaseJobToken(jobserver, workers[num_started].token);
+                        max_started = num_started;
+                    } else {
+                        DLOG("got a jobserver token for worker thread %u", num_started);
+                        num_started++;
+                    }
+                }
+            } while (runNextTask(&queue));
+        }
+        for (unsigned i=0U; i<num_started; i++)
+            pthread_join(workers[i].thread, NULL);
+        free(workers);
+        return atomic_load(&queue.all_succeeded);
+    }
+#else
+    (void)num_threads;
+    (void)jobserver;
+#endif // ARRGEN_THREADS_SUPPORTED
+    bool ret = true;
+    for (size_t i=0U; i<num_tasks; i++)
+        ret = task(i, arg) && ret;
+    return ret;
+}
+
+#ifdef ARRGEN_THREADS_SUPPORTED
+static bool startWorker(WorkerThread* worker, WorkerQueue* queue, unsigned number) {
+    worker->queue = queue;
+    int res = pthread_create(&worker->thread, NULL, workerMain, worker);
+    if (UNLIKELY(res!=0)) {
+        // not fatal, the threads that did start (and this one) will get through the queue anyway
+        errno = res;
+        myErrorErrno("could not start worker thread %u", number);
+        return false;
+    }
+    return true;
+}
+
+// false once there are no tasks left to start
+static bool runNextTask(WorkerQueue* queue) {
+    size_t index = atomic_fetch_add(&queue->next_index, 1U);
+    if (index>=queue->num_tasks)
+        return false;
+    if (!queue->task(index, queue->arg))
+        atomic_store(&queue->all_succeeded, false);
+    return true;
+}
+
+static void* workerMain(void* worker_ptr) {
+    WorkerThread *worker = (WorkerThread*)worker_ptr;
+    while (runNextTask(worker->queue));
+    // given back right away rather than after the other threads finish too, so make can start something else with it
+    if (worker->queue->jobserver!=NULL)
+        releaseJobToken(worker->queue->jobserver, worker->token);
+    return NULL;
+}
+#endif // ARRGEN_THREADS_SUPPORTED
+
+unsigned defaultNumThreads(void) {
+#if defined(_SC_NPROCESSORS_ONLN)
+    long num = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num>0L)
+        return (unsigned)num;
+#endif
+    return 1U;
+}
@@ -0,0 +1,49 @@
+/* Copyright © 2024 Steven Marion <steven@dragons.fish>
+ *
+ * This file is part of arrgen.
+ *
+ * arrgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * arrgen is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with arrgen.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKERS_H_INCLUDED
+#define WORKERS_H_INCLUDED
+#include "arrgen.h"
+#include "jobserver.h"
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef bool (*WorkerTask)(size_t index, void* arg);
+
+/**
+ * @brief calls task once for every index from 0 to num_tasks-1, spread over up to num_threads threads (including the calling one).
+ * each thread takes the next index as soon as it finishes its last one, so tasks don't all need to take the same time.
+ * without thread support, the tasks are run one at a time in order
+ * @param jobserver if not NULL, every thread other than the calling one only starts once it has a token from the jobserver,
+ * and gives it back as soon as there are no tasks left for it. num_threads is still the most that are used
+ * @param arg passed to every call of task
+ * @return true if every call of task returned true
+*/
+bool runParallel(size_t num_tasks, unsigned num_threads, Jobserver* jobserver, WorkerTask task, void* arg)
+    ATTR_NONNULL_N(4);
+
+/**
+ * @brief the number of threads to use if the user doesn't say, which is the number of online processors, or 1 if that isn't known
+*/
+unsigned defaultNumThreads(void);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // WORKERS_H_INCLUDED
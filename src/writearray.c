@@ -19,6 +19,11 @@
 #include "arrgen.h"
 #include "writearray.h"
 #include "errors.h"
+#include "stats.h"
+#ifdef ARRGEN_THREADS_SUPPORTED
+#   include <pthread.h>
+#   include <stdatomic.h>
+#endif
 
 #ifndef ARRGEN_NUM_REPEATS
 #   define ARRGEN_NUM_REPEATS 10U
@@ -29,47 +34,86 @@ typedef struct {
     uint8_t len;
 } ByteParams;
 
-static uint8_t base_;
-static bool aligned_;
-static ByteParams params_[256U];
-static char string_bank_[5U*256U*ARRGEN_NUM_REPEATS+1U] ATTR_NONSTRING; // TODO make this number less magic
+typedef struct {
+    ByteParams params[256U];
+    char string_bank[5U*256U*ARRGEN_NUM_REPEATS+1U] ATTR_NONSTRING; // TODO make this number less magic
+} LookupTable;
+
+// one table for each base and alignment, built the first time any thread asks for it and shared after that
+static LookupTable tables_[3U][2U];
+#ifdef ARRGEN_THREADS_SUPPORTED
+static atomic_bool tables_ready_[3U][2U];
+static pthread_mutex_t tables_mutex_ = PTHREAD_MUTEX_INITIALIZER;
+#else
+static bool tables_ready_[3U][2U];
+#endif
+// the table for the array this thread is writing
+static ARRGEN_THREAD_LOCAL const LookupTable *lookup_ = NULL;
+
+static void buildLookup(LookupTable *table, const char* format)
+    ATTR_ACCESS(write_only, 1)
+    ATTR_NONNULL;
 
 void initializeLookup(uint8_t base, bool aligned) {
-    if (base==base_ && aligned==aligned_)
-        return;
     const char* format;
+    unsigned base_index;
     switch(base) {
     case 8:
         format = aligned ? "0%.3o," : "0%o,";
+        base_index = 0U;
         break;
     case 10:
         format = aligned ? "%3u," : "%u,";
+        base_index = 1U;
         break;
     case 16:
         format = aligned ? "0x%.2X," : "0x%X,";
+        base_index = 2U;
         break;
     default:
         myFatal("unsupported base %u", (unsigned)base);
     }
-    base_ = base;
-    aligned_ = aligned;
+    LookupTable *table = &tables_[base_index][aligned];
+#ifdef ARRGEN_THREADS_SUPPORTED
+    if (!atomic_load_explicit(&tables_ready_[base_index][aligned], memory_order_acquire)) {
+        pthread_mutex_lock(&tables_mutex_);
+        if (!atomic_load_explicit(&tables_ready_[base_index][aligned], memory_order_relaxed)) {
+            buildLookup(table, format);
+            atomic_store_explicit(&tables_ready_[base_index][aligned], true, memory_order_release);
+        }
+        pthread_mutex_unlock(&tables_mutex_);
+    }
+#else
+    if (!tables_ready_[base_index][aligned]) {
+        buildLookup(table, format);
+        tables_ready_[base_index][aligned] = true;
+    }
+#endif
+    lookup_ = table;
+}
+
+static void buildLookup(LookupTable *table, const char* format) {
+    DLOG("building lookup table for format %s", format);
     unsigned cur_pos = 0;
     for (unsigned c=0U; c<256U; c++) {
-        params_[c].offset = cur_pos;
+        table->params[c].offset = cur_pos;
         int written_len;
         for (unsigned i = 0U; i<ARRGEN_NUM_REPEATS; i++) {
-            written_len = sprintf(&string_bank_[cur_pos], format, c);
+            written_len = sprintf(&table->string_bank[cur_pos], format, c);
             cur_pos += written_len;
         }
-        params_[c].len = written_len;
+        table->params[c].len = written_len;
     }
 }
 
 // TODO: make it return error information instead of quitting? or add some cleanup functionality to errors.c using global variables... probably I'll do that
 void writeArrayContents(FILE* out, const uint8_t *buf, size_t length, ssize_t *cur_line_pos, size_t line_limit) {
     size_t i=0;
+    const ByteParams *params = lookup_->params;
+    const char *string_bank = lookup_->string_bank;
     // TODO figure out if I want, or care, to remove the trailing comma with the lookup table implementation
     uint8_t num_to_print;
+    size_t num_lookups = 0U;
     if (UNLIKELY(*cur_line_pos < 0)) {
         *cur_line_pos = 0;
         fprintf(out, "\n    ");
@@ -78,7 +122,8 @@ void writeArrayContents(FILE* out, const uint8_t *buf, size_t length, ssize_t *c
         for (; i<length; i+=num_to_print) {
             uint8_t max_num_to_print = LIKELY(ARRGEN_NUM_REPEATS < (length-i)) ? ARRGEN_NUM_REPEATS : length-i;
             for (num_to_print = 1U; num_to_print < max_num_to_print && buf[i+num_to_print]==buf[i]; num_to_print++);
-            int cur_printed = fwrite(&string_bank_[params_[buf[i]].offset], params_[buf[i]].len, num_to_print, out);
+            num_lookups++;
+            int cur_printed = fwrite(&string_bank[params[buf[i]].offset], params[buf[i]].len, num_to_print, out);
             if (UNLIKELY(cur_printed != num_to_print))
                 myFatalErrno("fwrite");
             *cur_line_pos += num_to_print;
@@ -93,10 +138,13 @@ void writeArrayContents(FILE* out, const uint8_t *buf, size_t length, ssize_t *c
             if (UNLIKELY(line_limit-*cur_line_pos < max_num_to_print))
                 max_num_to_print = line_limit-*cur_line_pos;
             for (num_to_print = 1U; num_to_print < max_num_to_print && buf[i+num_to_print]==buf[i]; num_to_print++);
-            int cur_printed = fwrite(&string_bank_[params_[buf[i]].offset], params_[buf[i]].len, num_to_print, out);
+            num_lookups++;
+            int cur_printed = fwrite(&string_bank[params[buf[i]].offset], params[buf[i]].len, num_to_print, out);
             if (UNLIKELY(cur_printed != num_to_print))
                 myFatalErrno("fwrite");
             *cur_line_pos += num_to_print;
         }
     }
+    if (UNLIKELY(stats_enabled_))
+        statsCountLookups(num_lookups, length);
 }
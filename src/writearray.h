@@ -25,7 +25,8 @@ extern "C" {
 #endif // __cplusplus
 
 /**
- * @brief initialize the lookup table for the writeArrayContents function. must be called before it's run
+ * @brief initialize the lookup table for the writeArrayContents function. must be called before it's run, on the same thread.
+ * the tables are shared between threads, so each one is only built once
 */
 void initializeLookup(uint8_t base, bool aligned);
 